@@ -0,0 +1,90 @@
+#ifndef ACCEL_AABB_HPP
+#define ACCEL_AABB_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Geometry.cpp"
+
+// Axis aligned bounding box, starts out empty (min > max)
+struct AABB
+{
+	Vec3f min = Vec3f(std::numeric_limits<float>::max());
+	Vec3f max = Vec3f(-std::numeric_limits<float>::max());
+
+	AABB() = default;
+	AABB(const Vec3f& mi, const Vec3f& ma) :
+		min(mi),
+		max(ma)
+	{}
+
+	void Grow(const Vec3f& p)
+	{
+		min = Vec3f(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+		max = Vec3f(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+	}
+
+	void Grow(const AABB& box)
+	{
+		min = Vec3f(std::min(min.x, box.min.x), std::min(min.y, box.min.y), std::min(min.z, box.min.z));
+		max = Vec3f(std::max(max.x, box.max.x), std::max(max.y, box.max.y), std::max(max.z, box.max.z));
+	}
+
+	bool Empty() const
+	{
+		return min.x > max.x || min.y > max.y || min.z > max.z;
+	}
+
+	Vec3f Center() const
+	{
+		return (min + max) * 0.5f;
+	}
+
+	Vec3f Extent() const
+	{
+		return max - min;
+	}
+
+	float SurfaceArea() const
+	{
+		if (Empty())
+			return 0.0f;
+		const auto e = Extent();
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	// Slab test, invDir is 1 / direction (see SafeInverse)
+	bool Intersect(const Vec3f& orig, const Vec3f& invDir, const float tMax, float& tEntry) const
+	{
+		const float tx1 = (min.x - orig.x) * invDir.x;
+		const float tx2 = (max.x - orig.x) * invDir.x;
+		float tNear = std::min(tx1, tx2);
+		float tFar = std::max(tx1, tx2);
+
+		const float ty1 = (min.y - orig.y) * invDir.y;
+		const float ty2 = (max.y - orig.y) * invDir.y;
+		tNear = std::max(tNear, std::min(ty1, ty2));
+		tFar = std::min(tFar, std::max(ty1, ty2));
+
+		const float tz1 = (min.z - orig.z) * invDir.z;
+		const float tz2 = (max.z - orig.z) * invDir.z;
+		tNear = std::max(tNear, std::min(tz1, tz2));
+		tFar = std::min(tFar, std::max(tz1, tz2));
+
+		tEntry = tNear;
+		return tFar >= tNear && tFar >= 0.0f && tNear < tMax;
+	}
+};
+
+// Inverse ray direction without infinities (keeps the slab test free of NaNs)
+inline Vec3f SafeInverse(const Vec3f& dir)
+{
+	constexpr float eps = 1e-20f;
+	return Vec3f(
+		1.0f / (std::fabs(dir.x) > eps ? dir.x : std::copysign(eps, dir.x)),
+		1.0f / (std::fabs(dir.y) > eps ? dir.y : std::copysign(eps, dir.y)),
+		1.0f / (std::fabs(dir.z) > eps ? dir.z : std::copysign(eps, dir.z)));
+}
+
+#endif // ACCEL_AABB_HPP
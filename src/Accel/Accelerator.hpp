@@ -0,0 +1,72 @@
+#ifndef ACCEL_ACCELERATOR_HPP
+#define ACCEL_ACCELERATOR_HPP
+
+#include <memory>
+#include <string>
+
+#include "Accel/BVH.hpp"
+#include "Accel/BruteForce.hpp"
+#include "Accel/Grid.hpp"
+#include "Accel/QuantizedBVH.hpp"
+#include "Accel/WideBVH.hpp"
+#include "Constants.h"
+
+enum class AccelType
+{
+	Auto, // Brute force for small scenes, BVH otherwise
+	BruteForce,
+	BVH,
+	LBVH,
+	BVH4,
+	BVH8,
+	QBVH8,
+	QBVH16,
+	Grid,
+	HashGrid
+};
+
+inline AccelType ParseAccelType(const std::string& name)
+{
+	if (name == "brute")
+		return AccelType::BruteForce;
+	if (name == "bvh")
+		return AccelType::BVH;
+	if (name == "lbvh")
+		return AccelType::LBVH;
+	if (name == "bvh4")
+		return AccelType::BVH4;
+	if (name == "bvh8")
+		return AccelType::BVH8;
+	if (name == "qbvh")
+		return AccelType::QBVH8;
+	if (name == "qbvh16")
+		return AccelType::QBVH16;
+	if (name == "grid")
+		return AccelType::Grid;
+	if (name == "hashgrid")
+		return AccelType::HashGrid;
+	return AccelType::Auto;
+}
+
+// The BVHs build on buildWorkers, single threaded without them
+inline std::unique_ptr<IAccelerator> CreateAccelerator(AccelType type, const int numSpheres, util::Workers* buildWorkers = nullptr)
+{
+	if (type == AccelType::Auto)
+		type = numSpheres <= BRUTE_FORCE_MAX_SPHERES ? AccelType::BruteForce : AccelType::BVH;
+
+	switch (type)
+	{
+		case AccelType::BruteForce: return std::make_unique<BruteForce>();
+		case AccelType::LBVH: return std::make_unique<BVH>(buildWorkers, BVHBuilder::Morton);
+		case AccelType::BVH4: return std::make_unique<BVH4>(buildWorkers);
+		case AccelType::BVH8: return std::make_unique<BVH8>(buildWorkers);
+		case AccelType::QBVH8: return std::make_unique<QBVH8>(buildWorkers);
+		case AccelType::QBVH16: return std::make_unique<QBVH16>(buildWorkers);
+		case AccelType::Grid: return std::make_unique<Grid>(false);
+		case AccelType::HashGrid: return std::make_unique<Grid>(true);
+		case AccelType::BVH:
+		default: return std::make_unique<BVH>(buildWorkers);
+	}
+}
+
+#endif // ACCEL_ACCELERATOR_HPP
@@ -0,0 +1,868 @@
+#ifndef ACCEL_BVH_HPP
+#define ACCEL_BVH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "Accel/IAccelerator.hpp"
+#include "Accel/Morton.hpp"
+#include "Utility/Parallel.hpp"
+
+struct BVHNode
+{
+	AABB bounds;
+	int leftFirst = 0; // Inner node: left child (right child is leftFirst + 1), leaf: first index
+	int count = 0; // Number of spheres in a leaf, 0 for inner nodes
+
+	bool IsLeaf() const
+	{
+		return count > 0;
+	}
+};
+
+// Traversal stack entry, deliberately trivial so stacks don't get initialized per ray
+struct TraversalEntry
+{
+	int node;
+	float tEntry;
+};
+
+enum class BVHBuilder
+{
+	BinnedSAH, // Best trees, refitted while spheres move and rebuilt once they degraded
+	Morton // Linear BVH from sorted Morton codes, cheap enough to rebuild every frame
+};
+
+// Binary bounding volume hierarchy built with the binned surface area heuristic,
+// in parallel for large scenes, or as a linear BVH (LBVH) from Morton codes
+class BVH : public IAccelerator
+{
+public:
+	static constexpr int BINS = 16;
+	static constexpr int MAX_DEPTH = 64;
+	static constexpr int MAX_LEAF_SIZE = 8;
+	static constexpr int MORTON_LEAF_SIZE = 4;
+	// SAH cost of visiting a node relative to intersecting one sphere
+	static constexpr float TRAVERSAL_COST = 1.0f;
+
+	// Refitted trees are rebuilt once their SAH cost grew by this factor
+	float rebuildThreshold = 1.3f;
+	// Morton code length of the linear builder, 30 or 63 bits
+	int mortonBits = 30;
+
+	// Builds run their parallel parts on buildWorkers, or on the calling thread without them
+	explicit BVH(util::Workers* buildWorkers = nullptr, const BVHBuilder bvhBuilder = BVHBuilder::BinnedSAH) :
+		workers(buildWorkers),
+		buildThreads(buildWorkers ? buildWorkers->Size() : 1),
+		builder(bvhBuilder)
+	{}
+
+	void Build(const std::vector<Sphere>& sphereList) final
+	{
+		spheres = &sphereList;
+		const int n = (int)sphereList.size();
+		indices.resize(n);
+		primBounds.resize(n);
+		centers.resize(n);
+		util::ParallelFor(workers, n >= PARALLEL_MIN_SPHERES ? buildThreads : 1, n, [&](int, const int begin, const int end) {
+			for (int i = begin; i < end; i++)
+			{
+				indices[i] = i;
+				primBounds[i] = sphereList[i].Bounds();
+				centers[i] = sphereList[i].position;
+			}
+		});
+		BuildTree();
+	}
+
+	// Builds over arbitrary boxes such as instances, the tree can then only be queried with Traverse
+	void Build(const std::vector<AABB>& boxes)
+	{
+		spheres = nullptr;
+		const int n = (int)boxes.size();
+		indices.resize(n);
+		primBounds.assign(boxes.begin(), boxes.end());
+		centers.resize(n);
+		for (int i = 0; i < n; i++)
+		{
+			indices[i] = i;
+			centers[i] = boxes[i].Center();
+		}
+		BuildTree();
+	}
+
+	// Refits the bounds to the moved spheres, only rebuilds once the tree has degraded.
+	// Linear BVHs are always rebuilt.
+	void Update(const std::vector<Sphere>& sphereList) final
+	{
+		if (sphereList.size() != primBounds.size() || builder == BVHBuilder::Morton)
+		{
+			Build(sphereList);
+			return;
+		}
+
+		spheres = &sphereList;
+		Refit();
+		if (SahCost() > builtCost * rebuildThreshold)
+			Build(sphereList);
+	}
+
+	void Refit()
+	{
+		for (int i = 0; i < (int)primBounds.size(); i++)
+		{
+			primBounds[i] = (*spheres)[i].Bounds();
+		}
+		FitBounds(nodes, 0, (int)nodes.size());
+	}
+
+	// Expected cost of a random ray relative to the root
+	float SahCost() const
+	{
+		if (nodes.empty())
+			return 0.0f;
+
+		float cost = 0.0f;
+		for (const auto& node : nodes)
+		{
+			cost += node.bounds.SurfaceArea() * (node.IsLeaf() ? node.count : TRAVERSAL_COST);
+		}
+		return cost / nodes[0].bounds.SurfaceArea();
+	}
+
+	float BuiltCost() const
+	{
+		return builtCost;
+	}
+
+	int Rebuilds() const
+	{
+		return rebuilds;
+	}
+
+	RayHit Closest(const Vec3f& orig, const Vec3f& dir) const final
+	{
+		RayHit hit {};
+		float closest = std::numeric_limits<float>::max();
+		Traverse(orig, dir, closest, [&](const int prim) {
+			const float distance = (*spheres)[prim].HitDistance(orig, dir);
+			if (distance > 0 && distance < closest)
+			{
+				hit.distance = distance;
+				hit.prim = prim;
+				closest = distance;
+			}
+		});
+		return hit;
+	}
+
+	bool Occluded(const Vec3f& orig, const Vec3f& dir, const float maxDistance) const final
+	{
+		bool occluded = false;
+		float tMax = maxDistance;
+		Traverse(orig, dir, tMax, [&](const int prim) {
+			if (!occluded && (*spheres)[prim].Occludes(orig, dir, maxDistance))
+			{
+				// Nothing is closer than 0, which ends the traversal
+				occluded = true;
+				tMax = 0.0f;
+			}
+		});
+		return occluded;
+	}
+
+	bool TracesPackets() const final
+	{
+		return spheres != nullptr;
+	}
+
+	void ClosestPacket(const Packet& packet, RayHit* hits) const final
+	{
+		ClosestHits(packet, hits);
+	}
+
+	uint32_t OccludedPacket(const Packet& packet) const final
+	{
+		return OccludedRays(packet);
+	}
+
+	// Closest hits of a packet of any width, divergent packets are traced one ray at a time
+	template <int N>
+	void ClosestHits(const RayPacket<N>& packet, RayHit* hits) const
+	{
+		if (!packet.Coherent())
+		{
+			ClosestSingle(packet, hits);
+			return;
+		}
+
+		auto closest = packet.NoHits();
+		uint32_t live = packet.active;
+		TraversePacket(packet, closest.distance, live, [&](const int index, const uint32_t mask) {
+			packet.ClosestSphere((*spheres)[index], index, mask, closest);
+		});
+		RayPacket<N>::Store(closest, hits);
+	}
+
+	// Mask of the packet's rays blocked before their tMax
+	template <int N>
+	uint32_t OccludedRays(const RayPacket<N>& packet) const
+	{
+		if (!packet.Coherent())
+			return OccludedSingle(packet);
+
+		uint32_t occluded = 0;
+		auto tMax = packet.tMax;
+		uint32_t live = packet.active;
+		TraversePacket(packet, tMax, live, [&](const int index, const uint32_t mask) {
+			// Blocked rays leave the packet, traversal ends once none are left
+			const uint32_t blocked = packet.Blocked((*spheres)[index], mask);
+			occluded |= blocked;
+			live &= ~blocked;
+		});
+		return occluded;
+	}
+
+	// Packet version of Traverse: visits every node that one of the live rays hits before its
+	// closest distance and calls intersect(index, mask) with the rays that reached the leaf.
+	// The callback may lower closest and clear rays from live.
+	template <int N, typename F>
+	void TraversePacket(const RayPacket<N>& packet, typename RayPacket<N>::Floats& closest, uint32_t& live, F&& intersect) const
+	{
+		if (nodes.empty())
+			return;
+
+		int stack[MAX_DEPTH + 1];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0 && live)
+		{
+			const BVHNode& node = nodes[stack[--stackSize]];
+			typename RayPacket<N>::Floats tEntry;
+			const uint32_t mask = packet.IntersectBox(node.bounds, closest, tEntry) & live;
+			if (!mask)
+				continue;
+
+			if (node.IsLeaf())
+			{
+				for (int i = node.leftFirst; i < node.leftFirst + node.count && (mask & live); i++)
+				{
+					intersect(indices[i], mask & live);
+				}
+				continue;
+			}
+
+			// All rays share direction signs, so the child nearer along the first ray goes first
+			const int first = __builtin_ctz(mask);
+			const Vec3f dir = packet.Direction(first);
+			const BVHNode& left = nodes[node.leftFirst];
+			const BVHNode& right = nodes[node.leftFirst + 1];
+			const bool leftFirst = dir.dotProduct(left.bounds.Center()) <= dir.dotProduct(right.bounds.Center());
+			stack[stackSize++] = leftFirst ? node.leftFirst + 1 : node.leftFirst;
+			stack[stackSize++] = leftFirst ? node.leftFirst : node.leftFirst + 1;
+		}
+	}
+
+	// Visits the leaves along the ray front to back and calls intersect(index) for each of their
+	// primitives, which lowers closest on a hit so farther nodes get skipped
+	template <typename F>
+	void Traverse(const Vec3f& orig, const Vec3f& dir, float& closest, F&& intersect) const
+	{
+		if (nodes.empty())
+			return;
+
+		const Vec3f invDir = SafeInverse(dir);
+		float tEntry = 0;
+		if (!nodes[0].bounds.Intersect(orig, invDir, closest, tEntry))
+			return;
+
+		TraversalEntry stack[MAX_DEPTH + 1];
+		int stackSize = 0;
+		int current = 0;
+		while (true)
+		{
+			const BVHNode& node = nodes[current];
+			if (node.IsLeaf())
+			{
+				for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+				{
+					intersect(indices[i]);
+				}
+			}
+			else
+			{
+				// Visit the nearer child first, the other one goes on the stack
+				int near = node.leftFirst;
+				int far = near + 1;
+				float tNear = 0;
+				float tFar = 0;
+				bool hitNear = nodes[near].bounds.Intersect(orig, invDir, closest, tNear);
+				bool hitFar = nodes[far].bounds.Intersect(orig, invDir, closest, tFar);
+				if (hitNear && hitFar && tFar < tNear)
+				{
+					std::swap(near, far);
+					std::swap(tNear, tFar);
+				}
+				else if (!hitNear && hitFar)
+				{
+					std::swap(near, far);
+					std::swap(tNear, tFar);
+					std::swap(hitNear, hitFar);
+				}
+
+				if (hitNear)
+				{
+					if (hitFar)
+						stack[stackSize++] = { far, tFar };
+					current = near;
+					continue;
+				}
+			}
+
+			// Pop the next node that can still contain a closer hit
+			current = -1;
+			while (stackSize > 0)
+			{
+				const auto& entry = stack[--stackSize];
+				if (entry.tEntry < closest)
+				{
+					current = entry.node;
+					break;
+				}
+			}
+			if (current < 0)
+				break;
+		}
+	}
+
+	const char* Name() const final
+	{
+		return builder == BVHBuilder::Morton ? "lbvh" : "bvh";
+	}
+
+	const std::vector<BVHNode>& Nodes() const
+	{
+		return nodes;
+	}
+
+	const std::vector<int>& Indices() const
+	{
+		return indices;
+	}
+
+	// Size of what traversal touches: nodes and sphere indices
+	size_t MemoryBytes() const
+	{
+		return nodes.size() * sizeof(BVHNode) + indices.size() * sizeof(int);
+	}
+
+private:
+	static constexpr int PARALLEL_MIN_SPHERES = 4096;
+
+	struct Bins
+	{
+		AABB bounds[3][BINS];
+		int counts[3][BINS] = {};
+	};
+
+	struct Split
+	{
+		float cost = std::numeric_limits<float>::max();
+		int axis = -1;
+		int bin = 0;
+	};
+
+	void BuildTree()
+	{
+		nodes.clear();
+		const int n = (int)primBounds.size();
+		if (n == 0)
+			return;
+
+		nodes.reserve(2 * n - 1);
+		nodes.emplace_back();
+		nodes[0].count = n;
+
+		if (builder == BVHBuilder::Morton)
+		{
+			BuildMorton();
+		}
+		else if (buildThreads == 1 || n < PARALLEL_MIN_SPHERES)
+		{
+			BuildSubtree(nodes, 0);
+		}
+		else
+		{
+			BuildParallel();
+		}
+
+		builtCost = SahCost();
+		rebuilds++;
+	}
+
+	// A range of Morton sorted spheres that still has to be laid out below out[node]
+	struct MortonRange
+	{
+		int node;
+		int first;
+		int last;
+		int depth;
+	};
+
+	// Recomputes the bounds of out[begin, end) from primBounds. Children are stored after their
+	// parent, so walking backwards is bottom-up.
+	void FitBounds(std::vector<BVHNode>& out, const int begin, const int end) const
+	{
+		for (int i = end - 1; i >= begin; i--)
+		{
+			BVHNode& node = out[i];
+			if (node.IsLeaf())
+			{
+				node.bounds = RangeBounds(node.leftFirst, node.leftFirst + node.count);
+			}
+			else
+			{
+				node.bounds = out[node.leftFirst].bounds;
+				node.bounds.Grow(out[node.leftFirst + 1].bounds);
+			}
+		}
+	}
+
+	// Linear BVH: spheres are sorted along a Morton curve with a parallel radix sort, the tree then
+	// follows the implicit radix tree over the sorted codes. Every split is found by a binary search
+	// for the highest differing bit, so the hierarchy is emitted in a single linear pass. The top of
+	// the tree is laid out first, the subtrees below it concurrently.
+	void BuildMorton()
+	{
+		const int n = nodes[0].count;
+		const int threads = n >= PARALLEL_MIN_SPHERES ? buildThreads : 1;
+		const int bits = mortonBits <= 30 ? 30 : 63;
+
+		AABB centroidBounds;
+		RangeBounds(0, n, threads, &centroidBounds);
+		const Vec3f extent = centroidBounds.Extent();
+		const Vec3f scale(extent.x > 0 ? 1.0f / extent.x : 0.0f, extent.y > 0 ? 1.0f / extent.y : 0.0f, extent.z > 0 ? 1.0f / extent.z : 0.0f);
+		mortonCodes.resize(n);
+		util::ParallelFor(workers, threads, n, [&](int, const int begin, const int end) {
+			for (int i = begin; i < end; i++)
+			{
+				const Vec3f p = centers[i] - centroidBounds.min;
+				mortonCodes[i] = MortonCode(Vec3f(p.x * scale.x, p.y * scale.y, p.z * scale.z), bits);
+			}
+		});
+		RadixSort(mortonCodes, indices, bits, threads > 1 ? workers : nullptr);
+
+		if (threads == 1)
+		{
+			EmitMorton(nodes, { 0, 0, n - 1, 0 });
+			FitBounds(nodes, 0, (int)nodes.size());
+			return;
+		}
+
+		std::vector<MortonRange> tasks;
+		EmitMorton(nodes, { 0, 0, n - 1, 0 }, std::max(PARALLEL_MIN_SPHERES, n / (buildThreads * 8)), &tasks);
+		const int topNodes = (int)nodes.size();
+
+		// Every subtree is laid out and fitted on its own, then copied behind the top of the tree
+		std::vector<std::vector<BVHNode>> subtrees(tasks.size());
+		std::atomic<int> nextTask { 0 };
+		util::ParallelFor(workers, buildThreads, buildThreads, [&](int, int, int) {
+			for (int task = nextTask++; task < (int)tasks.size(); task = nextTask++)
+			{
+				auto& subtree = subtrees[task];
+				subtree.reserve(2 * (tasks[task].last - tasks[task].first) + 1);
+				subtree.emplace_back();
+				EmitMorton(subtree, { 0, tasks[task].first, tasks[task].last, tasks[task].depth });
+				FitBounds(subtree, 0, (int)subtree.size());
+			}
+		});
+
+		std::vector<int> offsets(tasks.size() + 1, topNodes);
+		for (int task = 0; task < (int)tasks.size(); task++)
+		{
+			offsets[task + 1] = offsets[task] + (int)subtrees[task].size() - 1;
+		}
+		nodes.resize(offsets.back());
+		util::ParallelFor(workers, buildThreads, (int)tasks.size(), [&](int, const int begin, const int end) {
+			for (int task = begin; task < end; task++)
+			{
+				const auto& subtree = subtrees[task];
+				const int offset = offsets[task] - 1;
+				for (int i = 0; i < (int)subtree.size(); i++)
+				{
+					BVHNode node = subtree[i];
+					if (!node.IsLeaf())
+						node.leftFirst += offset;
+					nodes[i == 0 ? tasks[task].node : offset + i] = node;
+				}
+			}
+		});
+		FitBounds(nodes, 0, topNodes);
+	}
+
+	// Splits the Morton sorted range depth first, ranges of up to MORTON_LEAF_SIZE spheres become
+	// leaves. With tasks given, ranges of up to taskSize spheres are left for later instead.
+	void EmitMorton(std::vector<BVHNode>& out, const MortonRange& root, const int taskSize = 0, std::vector<MortonRange>* tasks = nullptr) const
+	{
+		std::vector<MortonRange> stack { root };
+		while (!stack.empty())
+		{
+			const MortonRange range = stack.back();
+			stack.pop_back();
+
+			const int count = range.last - range.first + 1;
+			if (tasks && count <= taskSize)
+			{
+				tasks->push_back(range);
+				continue;
+			}
+			if (count <= MORTON_LEAF_SIZE || range.depth >= MAX_DEPTH)
+			{
+				out[range.node].leftFirst = range.first;
+				out[range.node].count = count;
+				continue;
+			}
+
+			const int split = MortonSplit(range.first, range.last);
+			const int left = (int)out.size();
+			out.emplace_back();
+			out.emplace_back();
+			out[range.node].leftFirst = left;
+			out[range.node].count = 0;
+			stack.push_back({ left + 1, split + 1, range.last, range.depth + 1 });
+			stack.push_back({ left, range.first, split, range.depth + 1 });
+		}
+	}
+
+	// Last sphere of the left half: binary search for where the highest bit differing between
+	// the first and last code flips. Ranges of equal codes are split in the middle.
+	int MortonSplit(const int first, const int last) const
+	{
+		const uint64_t firstCode = mortonCodes[first];
+		const uint64_t lastCode = mortonCodes[last];
+		if (firstCode == lastCode)
+			return (first + last) / 2;
+
+		const int prefix = __builtin_clzll(firstCode ^ lastCode);
+		int split = first;
+		int step = last - first;
+		do
+		{
+			step = (step + 1) >> 1;
+			const int candidate = split + step;
+			if (candidate < last && __builtin_clzll(firstCode ^ mortonCodes[candidate]) > prefix)
+				split = candidate;
+		} while (step > 1);
+		return split;
+	}
+
+	// Builds the tree below out[rootIndex] depth first, children are always stored after their parent
+	void BuildSubtree(std::vector<BVHNode>& out, const int rootIndex, const int rootDepth = 0)
+	{
+		std::vector<std::pair<int, int>> stack { { rootIndex, rootDepth } };
+		while (!stack.empty())
+		{
+			const auto [nodeIndex, depth] = stack.back();
+			stack.pop_back();
+
+			const int left = Subdivide(out, nodeIndex, depth, 1);
+			if (left < 0)
+				continue;
+
+			stack.push_back({ left + 1, depth + 1 });
+			stack.push_back({ left, depth + 1 });
+		}
+	}
+
+	// Large nodes near the root are split with all threads working on each node,
+	// the remaining subtrees are then built concurrently and appended to the tree
+	void BuildParallel()
+	{
+		const int taskSize = std::max(PARALLEL_MIN_SPHERES, nodes[0].count / (buildThreads * 8));
+		std::vector<std::pair<int, int>> tasks;
+		std::vector<std::pair<int, int>> stack { { 0, 0 } };
+		while (!stack.empty())
+		{
+			const auto [nodeIndex, depth] = stack.back();
+			stack.pop_back();
+			if (nodes[nodeIndex].count <= taskSize)
+			{
+				tasks.push_back({ nodeIndex, depth });
+				continue;
+			}
+
+			const int left = Subdivide(nodes, nodeIndex, depth, buildThreads);
+			if (left < 0)
+				continue;
+
+			stack.push_back({ left + 1, depth + 1 });
+			stack.push_back({ left, depth + 1 });
+		}
+
+		// Largest subtrees first for better load balance
+		std::sort(tasks.begin(), tasks.end(), [this](const auto& a, const auto& b) {
+			return nodes[a.first].count > nodes[b.first].count;
+		});
+
+		std::vector<std::vector<BVHNode>> subtrees(tasks.size());
+		std::atomic<int> nextTask { 0 };
+		util::ParallelFor(workers, buildThreads, buildThreads, [&](int, int, int) {
+			for (int task = nextTask++; task < (int)tasks.size(); task = nextTask++)
+			{
+				auto& subtree = subtrees[task];
+				subtree.push_back(nodes[tasks[task].first]);
+				BuildSubtree(subtree, 0, tasks[task].second);
+			}
+		});
+
+		for (int task = 0; task < (int)tasks.size(); task++)
+		{
+			const int offset = (int)nodes.size() - 1;
+			auto& subtree = subtrees[task];
+			for (int i = 0; i < (int)subtree.size(); i++)
+			{
+				BVHNode node = subtree[i];
+				if (!node.IsLeaf())
+					node.leftFirst += offset;
+				if (i == 0)
+					nodes[tasks[task].first] = node;
+				else
+					nodes.push_back(node);
+			}
+		}
+	}
+
+	// Computes the bounds of out[nodeIndex] and splits it, returns the index of the left child
+	// or -1 if the node stays a leaf
+	int Subdivide(std::vector<BVHNode>& out, const int nodeIndex, const int depth, const int threads)
+	{
+		const int first = out[nodeIndex].leftFirst;
+		const int count = out[nodeIndex].count;
+		AABB centroidBounds;
+		out[nodeIndex].bounds = RangeBounds(first, first + count, threads, &centroidBounds);
+		if (depth >= MAX_DEPTH || count <= 1)
+			return -1;
+
+		// Spheres sharing a center have no plane between them, they are split in the middle so
+		// leaves stay small (QuantizedBVH counts a leaf in 16 bits)
+		int leftCount = Partition(out[nodeIndex], centroidBounds, threads);
+		if (leftCount == 0 && count <= MAX_LEAF_SIZE)
+			return -1;
+		if (leftCount == 0)
+			leftCount = count / 2;
+
+		const int left = (int)out.size();
+		out.emplace_back();
+		out.emplace_back();
+		out[left].leftFirst = first;
+		out[left].count = leftCount;
+		out[left + 1].leftFirst = first + leftCount;
+		out[left + 1].count = count - leftCount;
+		out[nodeIndex].leftFirst = left;
+		out[nodeIndex].count = 0;
+		return left;
+	}
+
+	AABB RangeBounds(const int begin, const int end, const int threads = 1, AABB* centroidBounds = nullptr) const
+	{
+		if (threads > 1)
+		{
+			std::vector<AABB> bounds(threads);
+			std::vector<AABB> centroids(threads);
+			util::ParallelFor(workers, threads, end - begin, [&](const int t, const int chunkBegin, const int chunkEnd) {
+				bounds[t] = RangeBounds(begin + chunkBegin, begin + chunkEnd, 1, &centroids[t]);
+			});
+			for (int t = 1; t < threads; t++)
+			{
+				bounds[0].Grow(bounds[t]);
+				centroids[0].Grow(centroids[t]);
+			}
+			if (centroidBounds)
+				*centroidBounds = centroids[0];
+			return bounds[0];
+		}
+
+		AABB bounds;
+		AABB centroids;
+		for (int i = begin; i < end; i++)
+		{
+			bounds.Grow(primBounds[indices[i]]);
+			centroids.Grow(centers[indices[i]]);
+		}
+		if (centroidBounds)
+			*centroidBounds = centroids;
+		return bounds;
+	}
+
+	static int BinIndex(const float value, const float lower, const float scale)
+	{
+		return std::min(BINS - 1, (int)((value - lower) * scale));
+	}
+
+	// Reorders the node's spheres along the cheapest binned SAH split,
+	// returns the number of spheres on the left or 0 if the node stays a leaf
+	int Partition(const BVHNode& node, const AABB& centroidBounds, const int threads)
+	{
+		const int first = node.leftFirst;
+		const int count = node.count;
+
+		float scale[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			scale[axis] = extent > 0.0f ? BINS / extent : 0.0f;
+		}
+
+		const auto binRange = [&](Bins& bins, const int begin, const int end) {
+			for (int i = begin; i < end; i++)
+			{
+				const int prim = indices[i];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const int bin = BinIndex(centers[prim][axis], centroidBounds.min[axis], scale[axis]);
+					bins.counts[axis][bin]++;
+					bins.bounds[axis][bin].Grow(primBounds[prim]);
+				}
+			}
+		};
+
+		Bins bins;
+		if (threads == 1)
+		{
+			binRange(bins, first, first + count);
+		}
+		else
+		{
+			// Every thread bins its own chunk, the bins are merged afterwards
+			std::vector<Bins> threadBins(threads);
+			util::ParallelFor(workers, threads, count, [&](const int t, const int chunkBegin, const int chunkEnd) {
+				binRange(threadBins[t], first + chunkBegin, first + chunkEnd);
+			});
+			for (const auto& other : threadBins)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					for (int b = 0; b < BINS; b++)
+					{
+						bins.counts[axis][b] += other.counts[axis][b];
+						bins.bounds[axis][b].Grow(other.bounds[axis][b]);
+					}
+				}
+			}
+		}
+
+		Split best;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (scale[axis] <= 0.0f)
+				continue;
+
+			// Sweep from both sides to get the cost of every plane between two bins
+			float leftArea[BINS - 1];
+			int leftCounts[BINS - 1];
+			AABB leftBox;
+			int leftSum = 0;
+			for (int i = 0; i < BINS - 1; i++)
+			{
+				leftSum += bins.counts[axis][i];
+				leftBox.Grow(bins.bounds[axis][i]);
+				leftCounts[i] = leftSum;
+				leftArea[i] = leftBox.SurfaceArea();
+			}
+
+			AABB rightBox;
+			int rightSum = 0;
+			for (int i = BINS - 1; i > 0; i--)
+			{
+				rightSum += bins.counts[axis][i];
+				rightBox.Grow(bins.bounds[axis][i]);
+				if (leftCounts[i - 1] == 0 || rightSum == 0)
+					continue;
+				const float cost = leftCounts[i - 1] * leftArea[i - 1] + rightSum * rightBox.SurfaceArea();
+				if (cost < best.cost)
+				{
+					best.cost = cost;
+					best.axis = axis;
+					best.bin = i;
+				}
+			}
+		}
+
+		if (best.axis < 0)
+			return 0;
+
+		const float nodeArea = node.bounds.SurfaceArea();
+		if (TRAVERSAL_COST * nodeArea + best.cost >= count * nodeArea && count <= MAX_LEAF_SIZE)
+			return 0;
+
+		const float lower = centroidBounds.min[best.axis];
+		const float axisScale = scale[best.axis];
+		const auto goesLeft = [&](const int prim) {
+			return BinIndex(centers[prim][best.axis], lower, axisScale) < best.bin;
+		};
+
+		if (threads == 1)
+		{
+			int i = first;
+			int j = first + count - 1;
+			while (i <= j)
+			{
+				if (goesLeft(indices[i]))
+					i++;
+				else
+					std::swap(indices[i], indices[j--]);
+			}
+			return i - first;
+		}
+
+		// Stable out of place partition: count per chunk, then scatter to the chunk's offsets
+		std::vector<int> chunkLeft(threads, 0);
+		util::ParallelFor(workers, threads, count, [&](const int t, const int chunkBegin, const int chunkEnd) {
+			for (int i = first + chunkBegin; i < first + chunkEnd; i++)
+			{
+				chunkLeft[t] += goesLeft(indices[i]);
+			}
+		});
+		int leftTotal = 0;
+		for (const int c : chunkLeft)
+		{
+			leftTotal += c;
+		}
+
+		scratch.resize(indices.size());
+		util::ParallelFor(workers, threads, count, [&](const int t, const int chunkBegin, const int chunkEnd) {
+			int leftOffset = first;
+			for (int u = 0; u < t; u++)
+			{
+				leftOffset += chunkLeft[u];
+			}
+			int rightOffset = first + leftTotal + (chunkBegin - (leftOffset - first));
+			for (int i = first + chunkBegin; i < first + chunkEnd; i++)
+			{
+				const int prim = indices[i];
+				scratch[goesLeft(prim) ? leftOffset++ : rightOffset++] = prim;
+			}
+		});
+		util::ParallelFor(workers, threads, count, [&](int, const int chunkBegin, const int chunkEnd) {
+			std::copy(scratch.begin() + first + chunkBegin, scratch.begin() + first + chunkEnd, indices.begin() + first + chunkBegin);
+		});
+		return leftTotal;
+	}
+
+	std::vector<BVHNode> nodes;
+	std::vector<int> indices;
+	std::vector<AABB> primBounds;
+	std::vector<Vec3f> centers;
+	std::vector<int> scratch;
+	std::vector<uint64_t> mortonCodes;
+	util::Workers* workers;
+	int buildThreads;
+	BVHBuilder builder;
+	float builtCost = 0.0f;
+	int rebuilds = 0;
+};
+
+#endif // ACCEL_BVH_HPP
@@ -0,0 +1,37 @@
+#ifndef ACCEL_BRUTE_FORCE_HPP
+#define ACCEL_BRUTE_FORCE_HPP
+
+#include "Accel/IAccelerator.hpp"
+#include "Accel/SphereSoA.hpp"
+
+// Tests every ray against every sphere, a SIMD register of spheres at a time. Fastest for a
+// handful of spheres.
+class BruteForce : public IAccelerator
+{
+public:
+	void Build(const std::vector<Sphere>& sphereList) final
+	{
+		spheres = &sphereList;
+		hot.Build(sphereList);
+	}
+
+	RayHit Closest(const Vec3f& orig, const Vec3f& dir) const final
+	{
+		return hot.Closest(orig, dir, 1e6);
+	}
+
+	bool Occluded(const Vec3f& orig, const Vec3f& dir, const float maxDistance) const final
+	{
+		return hot.Occluded(orig, dir, maxDistance);
+	}
+
+	const char* Name() const final
+	{
+		return "brute";
+	}
+
+private:
+	SphereSoA hot;
+};
+
+#endif // ACCEL_BRUTE_FORCE_HPP
@@ -0,0 +1,212 @@
+#ifndef ACCEL_GRID_HPP
+#define ACCEL_GRID_HPP
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Accel/IAccelerator.hpp"
+
+// Uniform grid traversed with a 3D-DDA, built in linear time by counting sort.
+// The hashed variant sizes cells by the spheres instead of the scene extent and
+// folds them into a table sized by the sphere count, which suits sparse scenes.
+class Grid : public IAccelerator
+{
+public:
+	static constexpr float CELLS_PER_SPHERE = 3.0f;
+	static constexpr int MAX_RESOLUTION = 512;
+	static constexpr int MAX_HASHED_RESOLUTION = 4096;
+
+	explicit Grid(const bool hashedCells = false) :
+		hashed(hashedCells)
+	{}
+
+	void Build(const std::vector<Sphere>& sphereList) final
+	{
+		spheres = &sphereList;
+		const int n = (int)sphereList.size();
+
+		bounds = AABB();
+		for (const auto& sphere : sphereList)
+		{
+			bounds.Grow(sphere.Bounds());
+		}
+
+		// Roughly cubic cells, CELLS_PER_SPHERE cells per sphere on average but no smaller
+		// than a sphere. The hashed grid always uses sphere sized cells.
+		float radiusSum = 0.0f;
+		for (const auto& sphere : sphereList)
+		{
+			radiusSum += sphere.radius;
+		}
+		const float sphereCellsPerUnit = std::max(n, 1) / std::max(2.0f * radiusSum, 1e-6f);
+		const Vec3f extent = bounds.Extent();
+		const float volume = std::max(extent.x * extent.y * extent.z, 1e-12f);
+		float cellsPerUnit = std::min(sphereCellsPerUnit, std::cbrt(CELLS_PER_SPHERE * std::max(n, 1) / volume));
+		int maxResolution = MAX_RESOLUTION;
+		if (hashed)
+		{
+			cellsPerUnit = sphereCellsPerUnit;
+			maxResolution = MAX_HASHED_RESOLUTION;
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			resolution[axis] = std::max(1, std::min(maxResolution, (int)(extent[axis] * cellsPerUnit)));
+			cellSize[axis] = std::max(extent[axis], 1e-6f) / resolution[axis];
+			invCellSize[axis] = 1.0f / cellSize[axis];
+		}
+
+		size_t numCells = (size_t)resolution[0] * resolution[1] * resolution[2];
+		if (hashed)
+		{
+			numBuckets = 1;
+			while (numBuckets < (size_t)std::max(n, 1) * 2)
+				numBuckets <<= 1;
+			numCells = numBuckets;
+		}
+
+		// Counting sort: count, prefix sum, scatter
+		cellStart.assign(numCells + 1, 0);
+		for (int i = 0; i < n; i++)
+		{
+			ForEachCell(sphereList[i], [&](const size_t cell) { cellStart[cell + 1]++; });
+		}
+		for (size_t c = 0; c < numCells; c++)
+		{
+			cellStart[c + 1] += cellStart[c];
+		}
+		cellItems.resize(cellStart[numCells]);
+		cursor.assign(cellStart.begin(), cellStart.end() - 1);
+		for (int i = 0; i < n; i++)
+		{
+			ForEachCell(sphereList[i], [&](const size_t cell) { cellItems[cursor[cell]++] = i; });
+		}
+	}
+
+	RayHit Closest(const Vec3f& orig, const Vec3f& dir) const final
+	{
+		RayHit hit {};
+		float closest = std::numeric_limits<float>::max();
+		Traverse(orig, dir, closest, [&](const int prim) {
+			const float distance = (*spheres)[prim].HitDistance(orig, dir);
+			if (distance > 0 && distance < closest)
+			{
+				hit.distance = distance;
+				hit.prim = prim;
+				closest = distance;
+			}
+		});
+		return hit;
+	}
+
+	bool Occluded(const Vec3f& orig, const Vec3f& dir, const float maxDistance) const final
+	{
+		bool occluded = false;
+		float tMax = maxDistance;
+		Traverse(orig, dir, tMax, [&](const int prim) {
+			if (!occluded && (*spheres)[prim].Occludes(orig, dir, maxDistance))
+			{
+				occluded = true;
+				tMax = 0.0f;
+			}
+		});
+		return occluded;
+	}
+
+	// Walks the cells along the ray and calls intersect(index) for their spheres, which lowers
+	// closest on a hit. The walk ends once the next cell starts beyond closest.
+	template <typename F>
+	void Traverse(const Vec3f& orig, const Vec3f& dir, float& closest, F&& intersect) const
+	{
+		if (cellItems.empty())
+			return;
+
+		const Vec3f invDir = SafeInverse(dir);
+		float tEnter = 0;
+		if (!bounds.Intersect(orig, invDir, closest, tEnter))
+			return;
+		tEnter = std::max(tEnter, 0.0f);
+
+		// Setup the DDA at the point where the ray enters the grid
+		const Vec3f start = orig + dir * tEnter;
+		int cell[3];
+		int step[3];
+		float tNext[3];
+		float tDelta[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			cell[axis] = std::max(0, std::min(resolution[axis] - 1, (int)((start[axis] - bounds.min[axis]) * invCellSize[axis])));
+			step[axis] = dir[axis] >= 0 ? 1 : -1;
+			const float boundary = bounds.min[axis] + (cell[axis] + (step[axis] > 0 ? 1 : 0)) * cellSize[axis];
+			tNext[axis] = (boundary - orig[axis]) * invDir[axis];
+			tDelta[axis] = cellSize[axis] * std::fabs(invDir[axis]);
+		}
+
+		while (true)
+		{
+			const size_t index = CellIndex(cell[0], cell[1], cell[2]);
+			for (uint32_t i = cellStart[index]; i < cellStart[index + 1]; i++)
+			{
+				intersect(cellItems[i]);
+			}
+
+			// Spheres span several cells, a hit only counts once the ray left its cell
+			const int axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+			if (closest <= tNext[axis])
+				break;
+			cell[axis] += step[axis];
+			if (cell[axis] < 0 || cell[axis] >= resolution[axis])
+				break;
+			tNext[axis] += tDelta[axis];
+		}
+	}
+
+	const char* Name() const final
+	{
+		return hashed ? "hashgrid" : "grid";
+	}
+
+	int Resolution(const int axis) const
+	{
+		return resolution[axis];
+	}
+
+private:
+	size_t CellIndex(const int x, const int y, const int z) const
+	{
+		if (!hashed)
+			return ((size_t)z * resolution[1] + y) * resolution[0] + x;
+
+		const uint32_t h = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+		return h & (numBuckets - 1);
+	}
+
+	template <typename F>
+	void ForEachCell(const Sphere& sphere, F&& f) const
+	{
+		const AABB box = sphere.Bounds();
+		int lo[3];
+		int hi[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			lo[axis] = std::max(0, std::min(resolution[axis] - 1, (int)((box.min[axis] - bounds.min[axis]) * invCellSize[axis])));
+			hi[axis] = std::max(0, std::min(resolution[axis] - 1, (int)((box.max[axis] - bounds.min[axis]) * invCellSize[axis])));
+		}
+		for (int z = lo[2]; z <= hi[2]; z++)
+			for (int y = lo[1]; y <= hi[1]; y++)
+				for (int x = lo[0]; x <= hi[0]; x++)
+					f(CellIndex(x, y, z));
+	}
+
+	bool hashed;
+	size_t numBuckets = 0;
+	AABB bounds;
+	int resolution[3] = { 1, 1, 1 };
+	float cellSize[3] = { 1, 1, 1 };
+	float invCellSize[3] = { 1, 1, 1 };
+	std::vector<uint32_t> cellStart;
+	std::vector<uint32_t> cellItems;
+	std::vector<uint32_t> cursor;
+};
+
+#endif // ACCEL_GRID_HPP
@@ -0,0 +1,98 @@
+#ifndef ACCEL_IACCELERATOR_HPP
+#define ACCEL_IACCELERATOR_HPP
+
+#include <vector>
+
+#include "Accel/RayPacket.hpp"
+#include "Constants.h"
+#include "Scene.hpp"
+
+using Packet = RayPacket<PACKET_SIZE>;
+
+// Anything rays can be traced against: a sphere accelerator or instances of them
+struct IRayQuery
+{
+	virtual ~IRayQuery() = default;
+	// Closest primitive along the ray, distance == 0 means no hit
+	virtual RayHit Closest(const Vec3f& orig, const Vec3f& dir) const = 0;
+	// Full hit record for a hit returned by Closest
+	virtual Collision Shade(const Vec3f& orig, const Vec3f& dir, const RayHit& hit) const = 0;
+	// Any hit closer than maxDistance, for shadow rays. Stops at the first blocker.
+	virtual bool Occluded(const Vec3f& orig, const Vec3f& dir, const float maxDistance) const
+	{
+		const float distance = Closest(orig, dir).distance;
+		return distance > 0 && distance < maxDistance;
+	}
+
+	// Whether the packet queries below beat tracing the rays one by one
+	virtual bool TracesPackets() const
+	{
+		return false;
+	}
+	// Closest hits of the active rays in a packet before their tMax. Structures without a packet
+	// traversal trace the rays one by one.
+	virtual void ClosestPacket(const Packet& packet, RayHit* hits) const
+	{
+		ClosestSingle(packet, hits);
+	}
+	// Mask of the active rays blocked before their tMax
+	virtual uint32_t OccludedPacket(const Packet& packet) const
+	{
+		return OccludedSingle(packet);
+	}
+
+	// Both phases, same convention as Sphere::RayIntersection
+	Collision Intersect(const Vec3f& orig, const Vec3f& dir) const
+	{
+		const RayHit hit = Closest(orig, dir);
+		return hit.distance > 0 ? Shade(orig, dir, hit) : Collision {};
+	}
+	virtual const char* Name() const = 0;
+
+protected:
+	// Packet queries answered one ray at a time
+	template <int N>
+	void ClosestSingle(const RayPacket<N>& packet, RayHit* hits) const
+	{
+		for (int i = 0; i < N; i++)
+		{
+			hits[i] = (packet.active >> i) & 1 ? Closest(packet.Origin(i), packet.Direction(i)) : RayHit {};
+			if (hits[i].distance >= packet.tMax[i])
+				hits[i] = RayHit {};
+		}
+	}
+
+	template <int N>
+	uint32_t OccludedSingle(const RayPacket<N>& packet) const
+	{
+		uint32_t occluded = 0;
+		for (int i = 0; i < N; i++)
+		{
+			if ((packet.active >> i) & 1 && Occluded(packet.Origin(i), packet.Direction(i), packet.tMax[i]))
+				occluded |= 1u << i;
+		}
+		return occluded;
+	}
+};
+
+// Closest hit queries over the sphere list of a scene
+struct IAccelerator : IRayQuery
+{
+	// Spheres have to outlive the accelerator (no copy is made)
+	virtual void Build(const std::vector<Sphere>& spheres) = 0;
+	// Called after spheres moved, accelerators that can do better than a rebuild override this
+	virtual void Update(const std::vector<Sphere>& spheres)
+	{
+		Build(spheres);
+	}
+
+	Collision Shade(const Vec3f& orig, const Vec3f& dir, const RayHit& hit) const final
+	{
+		return (*spheres)[hit.prim].Shade(orig, dir, hit.distance);
+	}
+
+protected:
+	const std::vector<Sphere>* spheres = nullptr;
+};
+
+#endif // ACCEL_IACCELERATOR_HPP
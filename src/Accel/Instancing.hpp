@@ -0,0 +1,181 @@
+#ifndef ACCEL_INSTANCING_HPP
+#define ACCEL_INSTANCING_HPP
+
+#include <memory>
+#include <vector>
+
+#include "Accel/Accelerator.hpp"
+
+// Spheres in object space with their own acceleration structure, shared by any number of instances
+struct BottomLevel
+{
+	std::vector<Sphere> spheres;
+	std::unique_ptr<IAccelerator> accelerator;
+	AABB bounds;
+
+	BottomLevel(std::vector<Sphere> sphereList, const AccelType type = AccelType::Auto, util::Workers* buildWorkers = nullptr) :
+		spheres(std::move(sphereList)),
+		accelerator(CreateAccelerator(type, (int)spheres.size(), buildWorkers))
+	{
+		accelerator->Build(spheres);
+		for (const auto& sphere : spheres)
+		{
+			bounds.Grow(sphere.Bounds());
+		}
+	}
+};
+
+// A bottom level placed in the world, objectToWorld may rotate, scale and translate
+struct Instance
+{
+	std::shared_ptr<const BottomLevel> object;
+	Matrix44f objectToWorld;
+	Matrix44f worldToObject;
+
+	Instance(std::shared_ptr<const BottomLevel> bottomLevel, const Matrix44f& transform) :
+		object(std::move(bottomLevel))
+	{
+		SetTransform(transform);
+	}
+
+	void SetTransform(const Matrix44f& transform)
+	{
+		objectToWorld = transform;
+		worldToObject = transform.inverse();
+	}
+
+	// World space box around the transformed corners of the object bounds
+	AABB Bounds() const
+	{
+		AABB box;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			const Vec3f p(
+				corner & 1 ? object->bounds.max.x : object->bounds.min.x,
+				corner & 2 ? object->bounds.max.y : object->bounds.min.y,
+				corner & 4 ? object->bounds.max.z : object->bounds.min.z);
+			Vec3f world;
+			objectToWorld.multVecMatrix(p, world);
+			box.Grow(world);
+		}
+		return box;
+	}
+};
+
+// Two-level acceleration structure: a BVH over instances whose leaves trace the ray through the
+// shared bottom levels in object space. Moving instances only rebuilds the (small) top level.
+class TwoLevelBVH : public IRayQuery
+{
+public:
+	// Instances have to outlive the structure (no copy is made)
+	void Build(const std::vector<Instance>& instanceList)
+	{
+		instances = &instanceList;
+		instanceBounds.resize(instanceList.size());
+		for (size_t i = 0; i < instanceList.size(); i++)
+		{
+			instanceBounds[i] = instanceList[i].Bounds();
+		}
+		topLevel.Build(instanceBounds);
+	}
+
+	RayHit Closest(const Vec3f& orig, const Vec3f& dir) const final
+	{
+		RayHit hit {};
+		float closest = std::numeric_limits<float>::max();
+		topLevel.Traverse(orig, dir, closest, [&](const int index) {
+			const Instance& instance = (*instances)[index];
+
+			// Object space rays are normalized again, distances scale back by the direction length
+			Vec3f localOrig;
+			Vec3f localDir;
+			const float scale = ObjectRay(instance, orig, dir, localOrig, localDir);
+			const auto localHit = instance.object->accelerator->Closest(localOrig, localDir);
+			const float distance = localHit.distance / scale;
+			if (localHit.distance <= 0 || distance >= closest)
+				return;
+
+			hit.distance = distance;
+			hit.prim = localHit.prim;
+			hit.instance = index;
+			closest = distance;
+		});
+		return hit;
+	}
+
+	Collision Shade(const Vec3f& orig, const Vec3f& dir, const RayHit& hit) const final
+	{
+		const Instance& instance = (*instances)[hit.instance];
+		Vec3f localOrig;
+		Vec3f localDir;
+		const float scale = ObjectRay(instance, orig, dir, localOrig, localDir);
+		const RayHit localHit { hit.distance * scale, hit.prim, -1 };
+
+		Collision out = instance.object->accelerator->Shade(localOrig, localDir, localHit);
+		out.distance = hit.distance;
+		out.position = orig + dir * hit.distance;
+		out.normal = TransformNormal(instance.worldToObject, out.normal);
+		out.reflection = dir - out.normal * 2 * dir.dotProduct(out.normal);
+		return out;
+	}
+
+	bool Occluded(const Vec3f& orig, const Vec3f& dir, const float maxDistance) const final
+	{
+		bool occluded = false;
+		float tMax = maxDistance;
+		topLevel.Traverse(orig, dir, tMax, [&](const int index) {
+			if (occluded)
+				return;
+
+			const Instance& instance = (*instances)[index];
+			Vec3f localOrig;
+			Vec3f localDir;
+			const float scale = ObjectRay(instance, orig, dir, localOrig, localDir);
+			if (instance.object->accelerator->Occluded(localOrig, localDir, maxDistance * scale))
+			{
+				occluded = true;
+				tMax = 0.0f;
+			}
+		});
+		return occluded;
+	}
+
+	const char* Name() const final
+	{
+		return "instances";
+	}
+
+	const BVH& TopLevel() const
+	{
+		return topLevel;
+	}
+
+private:
+	// Ray in the instance's object space with a normalized direction, returns the length the
+	// direction had before normalizing (object space distance per world space unit)
+	static float ObjectRay(const Instance& instance, const Vec3f& orig, const Vec3f& dir, Vec3f& localOrig, Vec3f& localDir)
+	{
+		instance.worldToObject.multVecMatrix(orig, localOrig);
+		instance.worldToObject.multDirMatrix(dir, localDir);
+		const float scale = localDir.length();
+		localDir /= scale;
+		return scale;
+	}
+
+	// Normals go through the inverse transpose so they stay perpendicular under non-uniform scale
+	static Vec3f TransformNormal(const Matrix44f& worldToObject, const Vec3f& n)
+	{
+		Vec3f out(
+			n.x * worldToObject.x[0][0] + n.y * worldToObject.x[0][1] + n.z * worldToObject.x[0][2],
+			n.x * worldToObject.x[1][0] + n.y * worldToObject.x[1][1] + n.z * worldToObject.x[1][2],
+			n.x * worldToObject.x[2][0] + n.y * worldToObject.x[2][1] + n.z * worldToObject.x[2][2]);
+		out.normalize();
+		return out;
+	}
+
+	BVH topLevel;
+	std::vector<AABB> instanceBounds;
+	const std::vector<Instance>* instances = nullptr;
+};
+
+#endif // ACCEL_INSTANCING_HPP
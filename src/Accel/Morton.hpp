@@ -0,0 +1,94 @@
+#ifndef ACCEL_MORTON_HPP
+#define ACCEL_MORTON_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Geometry.cpp"
+#include "Utility/Parallel.hpp"
+
+// Spreads the lower 10 bits of v so there are two zero bits between each
+inline uint32_t ExpandBits10(uint32_t v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Spreads the lower 21 bits of v so there are two zero bits between each
+inline uint64_t ExpandBits21(uint64_t v)
+{
+	v &= 0x1fffff;
+	v = (v | (v << 32)) & 0x001f00000000ffffull;
+	v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+	v = (v | (v << 8)) & 0x100f00f00f00f00full;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+	v = (v | (v << 2)) & 0x1249249249249249ull;
+	return v;
+}
+
+// Morton code of a point inside [0, 1]^3 with 10 (30 bit code) or 21 (63 bit code) bits per axis
+inline uint64_t MortonCode(const Vec3f& p, const int bits)
+{
+	if (bits <= 30)
+	{
+		const auto q = [](const float f) { return (uint32_t)std::min(std::max(f * 1024.0f, 0.0f), 1023.0f); };
+		return (ExpandBits10(q(p.x)) << 2) | (ExpandBits10(q(p.y)) << 1) | ExpandBits10(q(p.z));
+	}
+	const auto q = [](const float f) { return (uint64_t)std::min(std::max(f * 2097152.0f, 0.0f), 2097151.0f); };
+	return (ExpandBits21(q(p.x)) << 2) | (ExpandBits21(q(p.y)) << 1) | ExpandBits21(q(p.z));
+}
+
+// Stable LSD radix sort of keys (and values alongside) on their lower `bits` bits, 8 bits per pass.
+// Every thread builds a histogram of its chunk, the scatter offsets are then laid out digit major,
+// thread minor so each thread writes its elements in order without synchronization.
+template <typename Value>
+void RadixSort(std::vector<uint64_t>& keys, std::vector<Value>& values, const int bits, util::Workers* workers = nullptr)
+{
+	const int n = (int)keys.size();
+	const int threads = std::max(1, std::min(workers ? workers->Size() : 1, n / 4096 + 1));
+	std::vector<uint64_t> keysTmp(n);
+	std::vector<Value> valuesTmp(n);
+	std::vector<int> histograms(threads * 256);
+
+	for (int shift = 0; shift < bits; shift += 8)
+	{
+		std::fill(histograms.begin(), histograms.end(), 0);
+		util::ParallelFor(workers, threads, n, [&](const int t, const int begin, const int end) {
+			int* histogram = &histograms[t * 256];
+			for (int i = begin; i < end; i++)
+			{
+				histogram[(keys[i] >> shift) & 0xff]++;
+			}
+		});
+
+		int offset = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			for (int t = 0; t < threads; t++)
+			{
+				const int count = histograms[t * 256 + digit];
+				histograms[t * 256 + digit] = offset;
+				offset += count;
+			}
+		}
+
+		util::ParallelFor(workers, threads, n, [&](const int t, const int begin, const int end) {
+			int* offsets = &histograms[t * 256];
+			for (int i = begin; i < end; i++)
+			{
+				const int dst = offsets[(keys[i] >> shift) & 0xff]++;
+				keysTmp[dst] = keys[i];
+				valuesTmp[dst] = values[i];
+			}
+		});
+		keys.swap(keysTmp);
+		values.swap(valuesTmp);
+	}
+}
+
+#endif // ACCEL_MORTON_HPP
@@ -0,0 +1,318 @@
+#ifndef ACCEL_QUANTIZED_BVH_HPP
+#define ACCEL_QUANTIZED_BVH_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "Accel/WideBVH.hpp"
+
+// Four children with bounds quantized to Q (uint8_t or uint16_t) relative to the node's own
+// box: child bounds are origin + q * 2^exponent, rounded outwards so they stay conservative.
+// The 8 bit node fills exactly one cache line, half of a float BVH4 node.
+template <typename Q>
+struct alignas(sizeof(Q) == 1 ? 64 : 32) QuantizedBVHNode
+{
+	float origin[3];
+	int8_t exponent[3];
+	Q lo[3][4]; // Per axis lower bound of every child
+	Q hi[3][4];
+	uint32_t child[4]; // Inner child: node index, leaf child: first index
+	uint16_t count[4]; // Spheres of a leaf child, 0 for inner children and empty slots
+};
+
+// BVH4 with quantized child bounds, decoded while traversing. Trades a few extra box hits
+// for far less memory traffic in scenes whose tree does not fit in cache.
+template <typename Q>
+class QuantizedBVH : public IAccelerator
+{
+	static_assert(std::is_same<Q, uint8_t>::value || std::is_same<Q, uint16_t>::value, "QuantizedBVH supports 8 and 16 bit bounds");
+
+public:
+	static constexpr int QMAX = std::numeric_limits<Q>::max();
+	static constexpr int STACK_SIZE = BVH::MAX_DEPTH * 4;
+
+	explicit QuantizedBVH(util::Workers* buildWorkers = nullptr, const BVHBuilder builder = BVHBuilder::BinnedSAH) :
+		binary(buildWorkers, builder)
+	{}
+
+	void Build(const std::vector<Sphere>& sphereList) final
+	{
+		spheres = &sphereList;
+		binary.Build(sphereList);
+		Quantize();
+	}
+
+	void Update(const std::vector<Sphere>& sphereList) final
+	{
+		spheres = &sphereList;
+		binary.Update(sphereList);
+		Quantize();
+	}
+
+	RayHit Closest(const Vec3f& orig, const Vec3f& dir) const final
+	{
+		RayHit hit {};
+		float closest = std::numeric_limits<float>::max();
+		Traverse(orig, dir, closest, [&](const int prim) {
+			const float distance = (*spheres)[prim].HitDistance(orig, dir);
+			if (distance > 0 && distance < closest)
+			{
+				hit.distance = distance;
+				hit.prim = prim;
+				closest = distance;
+			}
+		});
+		return hit;
+	}
+
+	bool Occluded(const Vec3f& orig, const Vec3f& dir, const float maxDistance) const final
+	{
+		bool occluded = false;
+		float tMax = maxDistance;
+		Traverse(orig, dir, tMax, [&](const int prim) {
+			if (!occluded && (*spheres)[prim].Occludes(orig, dir, maxDistance))
+			{
+				occluded = true;
+				tMax = 0.0f;
+			}
+		});
+		return occluded;
+	}
+
+	// Same contract as BVH::Traverse
+	template <typename F>
+	void Traverse(const Vec3f& orig, const Vec3f& dir, float& closest, F&& intersect) const
+	{
+		if (nodes.empty())
+			return;
+
+		const Vec3f invDir = SafeInverse(dir);
+		float tEntry = 0;
+		if (!binary.Nodes()[0].bounds.Intersect(orig, invDir, closest, tEntry))
+			return;
+
+		const auto& indices = binary.Indices();
+		TraversalEntry stack[STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = { 0, tEntry };
+		while (stackSize > 0)
+		{
+			const auto entry = stack[--stackSize];
+			if (entry.tEntry >= closest)
+				continue;
+
+			const QuantizedBVHNode<Q>& node = nodes[entry.node];
+			float tNear[4];
+			int mask = IntersectChildren(node, orig, invDir, closest, tNear);
+
+			// Leaves are intersected right away, inner children are pushed far to near
+			int order[4];
+			int numInner = 0;
+			while (mask)
+			{
+				const int i = __builtin_ctz(mask);
+				mask &= mask - 1;
+				if (node.count[i] > 0)
+				{
+					for (uint32_t j = node.child[i]; j < node.child[i] + node.count[i]; j++)
+					{
+						intersect(indices[j]);
+					}
+				}
+				else
+				{
+					int k = numInner++;
+					while (k > 0 && tNear[order[k - 1]] < tNear[i])
+					{
+						order[k] = order[k - 1];
+						k--;
+					}
+					order[k] = i;
+				}
+			}
+			for (int k = 0; k < numInner; k++)
+			{
+				stack[stackSize++] = { (int)node.child[order[k]], tNear[order[k]] };
+			}
+		}
+	}
+
+	const char* Name() const final
+	{
+		return sizeof(Q) == 1 ? "qbvh" : "qbvh16";
+	}
+
+	const std::vector<QuantizedBVHNode<Q>>& Nodes() const
+	{
+		return nodes;
+	}
+
+	const BVH& Binary() const
+	{
+		return binary;
+	}
+
+	// Size of what traversal touches: nodes and sphere indices
+	size_t MemoryBytes() const
+	{
+		return nodes.size() * sizeof(QuantizedBVHNode<Q>) + binary.Indices().size() * sizeof(int);
+	}
+
+	// Decoded bounds of a child, for validation
+	static AABB ChildBounds(const QuantizedBVHNode<Q>& node, const int i)
+	{
+		AABB box;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float scale = ExponentScale(node.exponent[axis]);
+			box.min[axis] = node.origin[axis] + node.lo[axis][i] * scale;
+			box.max[axis] = node.origin[axis] + node.hi[axis][i] * scale;
+		}
+		return box;
+	}
+
+private:
+	// Returns a bit mask of the children hit before tMax, tNear gets their entry distances.
+	// With power of two scales the slab distance of plane q is q * (scale * invDir) + (origin - orig) * invDir.
+	static int IntersectChildren(const QuantizedBVHNode<Q>& node, const Vec3f& orig, const Vec3f& invDir, const float tMax, float* tNear)
+	{
+#if defined(__SSE2__) || defined(_M_X64)
+		__m128 tn = _mm_setzero_ps();
+		__m128 tf = _mm_set1_ps(tMax);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float scale = ExponentScale(node.exponent[axis]);
+			const __m128 a = _mm_set1_ps(scale * invDir[axis]);
+			const __m128 b = _mm_set1_ps((node.origin[axis] - orig[axis]) * invDir[axis]);
+			const bool negative = invDir[axis] < 0;
+			const __m128 tLo = _mm_add_ps(_mm_mul_ps(Decode(node.lo[axis]), a), b);
+			const __m128 tHi = _mm_add_ps(_mm_mul_ps(Decode(node.hi[axis]), a), b);
+			tn = _mm_max_ps(tn, negative ? tHi : tLo);
+			tf = _mm_min_ps(tf, negative ? tLo : tHi);
+		}
+		_mm_storeu_ps(tNear, tn);
+		return _mm_movemask_ps(_mm_cmple_ps(tn, tf));
+#else
+		float tn[4] = { 0, 0, 0, 0 };
+		float tf[4] = { tMax, tMax, tMax, tMax };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float a = ExponentScale(node.exponent[axis]) * invDir[axis];
+			const float b = (node.origin[axis] - orig[axis]) * invDir[axis];
+			const bool negative = invDir[axis] < 0;
+			for (int i = 0; i < 4; i++)
+			{
+				const float tLo = node.lo[axis][i] * a + b;
+				const float tHi = node.hi[axis][i] * a + b;
+				tn[i] = std::max(tn[i], negative ? tHi : tLo);
+				tf[i] = std::min(tf[i], negative ? tLo : tHi);
+			}
+		}
+		int mask = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			tNear[i] = tn[i];
+			mask |= (tn[i] <= tf[i]) << i;
+		}
+		return mask;
+#endif
+	}
+
+	// 2^exponent straight from the float bits
+	static float ExponentScale(const int exponent)
+	{
+		const uint32_t bits = (uint32_t)(exponent + 127) << 23;
+		float scale;
+		std::memcpy(&scale, &bits, sizeof(scale));
+		return scale;
+	}
+
+#if defined(__SSE2__) || defined(_M_X64)
+	// Widens four quantized values to floats
+	static __m128 Decode(const Q* q)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		if constexpr (sizeof(Q) == 1)
+		{
+			int packed;
+			std::memcpy(&packed, q, sizeof(packed));
+			const __m128i bytes = _mm_cvtsi32_si128(packed);
+			return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+		}
+		else
+		{
+			const __m128i words = _mm_loadl_epi64((const __m128i*)q);
+			return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+		}
+	}
+#endif
+
+	void Quantize()
+	{
+		std::vector<WideBVHNode<4>> wide;
+		BVH4::Collapse(binary, wide);
+		nodes.resize(wide.size());
+		for (size_t n = 0; n < wide.size(); n++)
+		{
+			const WideBVHNode<4>& source = wide[n];
+			QuantizedBVHNode<Q>& node = nodes[n];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float lower = std::numeric_limits<float>::max();
+				float upper = -std::numeric_limits<float>::max();
+				for (int i = 0; i < 4; i++)
+				{
+					if (source.count[i] < 0)
+						continue;
+					lower = std::min(lower, source.bounds[axis][i]);
+					upper = std::max(upper, source.bounds[axis + 3][i]);
+				}
+
+				// Smallest power of two that spans the node in QMAX - 1 steps, the spare step
+				// absorbs rounding of origin + q * scale
+				int exponent = 0;
+				std::frexp((upper - lower) / (QMAX - 1), &exponent);
+				exponent = std::max(-126, std::min(127, exponent));
+				const float scale = ExponentScale(exponent);
+				node.origin[axis] = lower;
+				node.exponent[axis] = (int8_t)exponent;
+
+				for (int i = 0; i < 4; i++)
+				{
+					if (source.count[i] < 0)
+					{
+						// Inverted bounds are never hit
+						node.lo[axis][i] = QMAX;
+						node.hi[axis][i] = 0;
+						continue;
+					}
+					int lo = std::max(0, (int)std::floor((source.bounds[axis][i] - lower) / scale));
+					while (lo > 0 && lower + lo * scale > source.bounds[axis][i])
+						lo--;
+					int hi = std::min(QMAX, (int)std::ceil((source.bounds[axis + 3][i] - lower) / scale));
+					while (hi < QMAX && lower + hi * scale < source.bounds[axis + 3][i])
+						hi++;
+					node.lo[axis][i] = (Q)lo;
+					node.hi[axis][i] = (Q)hi;
+				}
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				node.child[i] = (uint32_t)std::max(source.child[i], 0);
+				node.count[i] = (uint16_t)std::max(source.count[i], 0);
+			}
+		}
+	}
+
+	BVH binary;
+	std::vector<QuantizedBVHNode<Q>> nodes;
+};
+
+using QBVH8 = QuantizedBVH<uint8_t>;
+using QBVH16 = QuantizedBVH<uint16_t>;
+
+#endif // ACCEL_QUANTIZED_BVH_HPP
@@ -0,0 +1,250 @@
+#ifndef ACCEL_RAY_PACKET_HPP
+#define ACCEL_RAY_PACKET_HPP
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64)
+	#include <immintrin.h>
+#endif
+
+#include "Accel/AABB.hpp"
+#include "Scene.hpp"
+
+// Vector extension types per packet width (the attribute can't depend on a template parameter)
+template <int N>
+struct PacketLanes;
+
+template <>
+struct PacketLanes<4>
+{
+	typedef float Floats __attribute__((vector_size(16)));
+	typedef int32_t Ints __attribute__((vector_size(16)));
+};
+
+template <>
+struct PacketLanes<8>
+{
+	typedef float Floats __attribute__((vector_size(32)));
+	typedef int32_t Ints __attribute__((vector_size(32)));
+};
+
+template <>
+struct PacketLanes<16>
+{
+	typedef float Floats __attribute__((vector_size(64)));
+	typedef int32_t Ints __attribute__((vector_size(64)));
+};
+
+// N rays with one SIMD lane each. Uses the GCC / Clang vector extensions, which lower to the
+// widest registers the target has (a 16 ray packet is four SSE or one AVX-512 register).
+// Only rays with their bit set in active take part, the other lanes hold harmless values.
+template <int N>
+struct RayPacket
+{
+	static_assert(N == 4 || N == 8 || N == 16, "Ray packets hold 4, 8 or 16 rays");
+
+	using Floats = typename PacketLanes<N>::Floats;
+	using Ints = typename PacketLanes<N>::Ints;
+
+	Floats ox {}, oy {}, oz {};
+	Floats dx {}, dy {}, dz {};
+	Floats ix {}, iy {}, iz {}; // SafeInverse of the directions
+	Floats tMax {}; // Hits at or beyond this distance are ignored
+	uint32_t active = 0;
+
+	// Closest hits found so far, one lane per ray
+	struct Hits
+	{
+		Floats distance;
+		Ints prim;
+	};
+
+	void Set(const int i, const Vec3f& orig, const Vec3f& dir, const float maxDistance)
+	{
+		const Vec3f invDir = SafeInverse(dir);
+		ox[i] = orig.x;
+		oy[i] = orig.y;
+		oz[i] = orig.z;
+		dx[i] = dir.x;
+		dy[i] = dir.y;
+		dz[i] = dir.z;
+		ix[i] = invDir.x;
+		iy[i] = invDir.y;
+		iz[i] = invDir.z;
+		tMax[i] = maxDistance;
+		active |= 1u << i;
+	}
+
+	Vec3f Origin(const int i) const
+	{
+		return Vec3f(ox[i], oy[i], oz[i]);
+	}
+
+	Vec3f Direction(const int i) const
+	{
+		return Vec3f(dx[i], dy[i], dz[i]);
+	}
+
+	int Count() const
+	{
+		return __builtin_popcount(active);
+	}
+
+	// Packets only pay off while their rays visit the same nodes. Rays whose directions differ
+	// in sign diverge right away, single rays have nothing to share.
+	bool Coherent() const
+	{
+		if (Count() < 2)
+			return false;
+		const Floats zero {};
+		for (const uint32_t positive : { Bits(dx >= zero), Bits(dy >= zero), Bits(dz >= zero) })
+		{
+			if ((positive & active) != 0 && (positive & active) != active)
+				return false;
+		}
+		return true;
+	}
+
+	// Lane i of lanes is set if bit i of the mask is
+	static void Lanes(const uint32_t mask, Ints& lanes)
+	{
+		Ints bits;
+		for (int i = 0; i < N; i++)
+		{
+			bits[i] = 1 << i;
+		}
+		lanes = ((Ints {} + (int32_t)mask) & bits) != 0;
+	}
+
+	// Bit i of the result is set if lane i is (lanes are 0 or -1 as comparisons give them)
+	static uint32_t Bits(const Ints& lanes)
+	{
+		uint32_t mask = 0;
+#if defined(__SSE__) || defined(_M_X64)
+		const __m128* quads = reinterpret_cast<const __m128*>(&lanes);
+		for (int k = 0; k < N / 4; k++)
+		{
+			mask |= (uint32_t)_mm_movemask_ps(quads[k]) << (4 * k);
+		}
+#else
+		for (int i = 0; i < N; i++)
+		{
+			mask |= (lanes[i] != 0 ? 1u : 0u) << i;
+		}
+#endif
+		return mask;
+	}
+
+	// Packets are only passed by reference: a packet wider than the build target passed or
+	// returned by value would change the calling convention, which GCC warns about
+	static void Min(Floats& a, const Floats& b)
+	{
+		a = a < b ? a : b;
+	}
+
+	static void Max(Floats& a, const Floats& b)
+	{
+		a = a > b ? a : b;
+	}
+
+	static void Sqrt(Floats& x)
+	{
+#if defined(__SSE__) || defined(_M_X64)
+		// Vector types and __m128 may alias each other
+		__m128* quads = reinterpret_cast<__m128*>(&x);
+		for (int k = 0; k < N / 4; k++)
+		{
+			quads[k] = _mm_sqrt_ps(quads[k]);
+		}
+#else
+		for (int i = 0; i < N; i++)
+		{
+			x[i] = std::sqrt(x[i]);
+		}
+#endif
+	}
+
+	// Slab test of every ray against the box (same rules as AABB::Intersect), returns the rays
+	// that hit it before tLimit and their entry distances
+	uint32_t IntersectBox(const AABB& box, const Floats& tLimit, Floats& tEntry) const
+	{
+		const Floats tx1 = (box.min.x - ox) * ix;
+		const Floats tx2 = (box.max.x - ox) * ix;
+		const Floats ty1 = (box.min.y - oy) * iy;
+		const Floats ty2 = (box.max.y - oy) * iy;
+		const Floats tz1 = (box.min.z - oz) * iz;
+		const Floats tz2 = (box.max.z - oz) * iz;
+		Floats tNear = tx1, yNear = ty1, zNear = tz1;
+		Min(tNear, tx2);
+		Min(yNear, ty2);
+		Min(zNear, tz2);
+		Max(tNear, yNear);
+		Max(tNear, zNear);
+		Floats tFar = tx1, yFar = ty1, zFar = tz1;
+		Max(tFar, tx2);
+		Max(yFar, ty2);
+		Max(zFar, tz2);
+		Min(tFar, yFar);
+		Min(tFar, zFar);
+		const Floats zero {};
+		tEntry = tNear;
+		return Bits((tFar >= tNear) & (tFar >= zero) & (tNear < tLimit));
+	}
+
+	// Sphere::HitDistance for every lane, 0 for misses
+	void HitDistances(const Sphere& sphere, Floats& distance) const
+	{
+		const Floats ocx = ox - sphere.position.x;
+		const Floats ocy = oy - sphere.position.y;
+		const Floats ocz = oz - sphere.position.z;
+		const Floats p = dx * ocx + dy * ocy + dz * ocz;
+		const Floats lx = ocx - dx * p;
+		const Floats ly = ocy - dy * p;
+		const Floats lz = ocz - dz * p;
+		const Floats discriminant = sphere.radius * sphere.radius - (lx * lx + ly * ly + lz * lz);
+		const Floats zero {};
+		Floats root = discriminant;
+		Max(root, zero);
+		Sqrt(root);
+		const Floats dist = -p - root;
+		distance = (discriminant >= zero) & (dist > zero) ? dist : zero;
+	}
+
+	Hits NoHits() const
+	{
+		return { tMax, Ints {} - 1 };
+	}
+
+	// Records the sphere for the rays in mask that hit it before their closest hit so far
+	void ClosestSphere(const Sphere& sphere, const int index, const uint32_t mask, Hits& hits) const
+	{
+		Floats distance;
+		HitDistances(sphere, distance);
+		const Floats zero {};
+		Ints selected;
+		Lanes(mask, selected);
+		const Ints closer = (distance > zero) & (distance < hits.distance) & selected;
+		hits.distance = closer ? distance : hits.distance;
+		hits.prim = closer ? Ints {} + index : hits.prim;
+	}
+
+	// Rays in mask the sphere blocks before their tMax
+	uint32_t Blocked(const Sphere& sphere, const uint32_t mask) const
+	{
+		Floats distance;
+		HitDistances(sphere, distance);
+		const Floats zero {};
+		return Bits((distance > zero) & (distance < tMax)) & mask;
+	}
+
+	static void Store(const Hits& hits, RayHit* out)
+	{
+		for (int i = 0; i < N; i++)
+		{
+			out[i] = hits.prim[i] >= 0 ? RayHit { hits.distance[i], hits.prim[i], -1 } : RayHit {};
+		}
+	}
+};
+
+#endif // ACCEL_RAY_PACKET_HPP
@@ -0,0 +1,83 @@
+// Sphere tests of SphereSoA for one instruction set. Included by SphereSoA.hpp once per
+// instruction set, inside a namespace that defines Lanes and under the matching
+// #pragma GCC target, so every variant is compiled with its own registers.
+
+// Tests spheres first .. first + WIDTH, t gets the distances and the result flags the hits
+inline int Block(const Spheres& s, const Vec3f& orig, const Vec3f& dir, const int first, const Lanes::F tMax, Lanes::F& t)
+{
+	using L = Lanes;
+	const L::F ocx = L::Sub(L::Set1(orig.x), L::Load(&s.cx[first]));
+	const L::F ocy = L::Sub(L::Set1(orig.y), L::Load(&s.cy[first]));
+	const L::F ocz = L::Sub(L::Set1(orig.z), L::Load(&s.cz[first]));
+	const L::F p = L::Add(L::Add(L::Mul(L::Set1(dir.x), ocx), L::Mul(L::Set1(dir.y), ocy)), L::Mul(L::Set1(dir.z), ocz));
+	// Same stable discriminant as Sphere::HitDistance: r^2 - |perpendicular|^2
+	const L::F lx = L::Sub(ocx, L::Mul(L::Set1(dir.x), p));
+	const L::F ly = L::Sub(ocy, L::Mul(L::Set1(dir.y), p));
+	const L::F lz = L::Sub(ocz, L::Mul(L::Set1(dir.z), p));
+	const L::F discriminant = L::Sub(L::Load(&s.r2[first]), L::Add(L::Add(L::Mul(lx, lx), L::Mul(ly, ly)), L::Mul(lz, lz)));
+	// Negative discriminants give NaN here, which fail every comparison in Hits
+	t = L::Sub(L::Sub(L::Set1(0.0f), p), L::Sqrt(discriminant));
+	return L::Hits(discriminant, t, tMax);
+}
+
+// Closest sphere hit before tMax, same distances as Sphere::HitDistance
+inline RayHit Closest(const Spheres& s, const Vec3f& orig, const Vec3f& dir, float tMax)
+{
+	using L = Lanes;
+	RayHit hit {};
+	int i = 0;
+	// Without SIMD every sphere goes through the scalar test
+	for (; L::WIDTH > 1 && i + L::WIDTH <= s.count; i += L::WIDTH)
+	{
+		L::F t;
+		int mask = Block(s, orig, dir, i, L::Set1(tMax), t);
+		if (!mask)
+			continue;
+
+		// Hits are rare, the few lanes that did hit are sorted out one by one
+		float distances[L::WIDTH];
+		L::Store(distances, t);
+		while (mask)
+		{
+			const int lane = __builtin_ctz(mask);
+			mask &= mask - 1;
+			if (distances[lane] < tMax)
+			{
+				tMax = distances[lane];
+				hit.distance = tMax;
+				hit.prim = i + lane;
+			}
+		}
+	}
+	for (; i < s.count; i++)
+	{
+		const float distance = s.Distance(orig, dir, i);
+		if (distance > 0 && distance < tMax)
+		{
+			tMax = distance;
+			hit.distance = distance;
+			hit.prim = i;
+		}
+	}
+	return hit;
+}
+
+inline bool Occluded(const Spheres& s, const Vec3f& orig, const Vec3f& dir, const float maxDistance)
+{
+	using L = Lanes;
+	const L::F tMax = L::Set1(maxDistance);
+	int i = 0;
+	for (; L::WIDTH > 1 && i + L::WIDTH <= s.count; i += L::WIDTH)
+	{
+		L::F t;
+		if (Block(s, orig, dir, i, tMax, t))
+			return true;
+	}
+	for (; i < s.count; i++)
+	{
+		const float distance = s.Distance(orig, dir, i);
+		if (distance > 0 && distance < maxDistance)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,295 @@
+#ifndef ACCEL_SPHERE_SOA_HPP
+#define ACCEL_SPHERE_SOA_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "Scene.hpp"
+#include "Utility/Cpu.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+#elif defined(UTIL_NEON_VARIANTS)
+	#pragma GCC push_options
+	#if defined(__arm__)
+		#pragma GCC target("fpu=neon")
+	#endif
+	#include <arm_neon.h>
+	#pragma GCC pop_options
+#endif
+
+namespace soa
+{
+// The arrays a kernel reads
+struct Spheres
+{
+	const float* cx;
+	const float* cy;
+	const float* cz;
+	const float* r2;
+	int count;
+
+	// Scalar test of sphere i, for the spheres that don't fill a register
+	float Distance(const Vec3f& orig, const Vec3f& dir, const int i) const
+	{
+		const float ocx = orig.x - cx[i];
+		const float ocy = orig.y - cy[i];
+		const float ocz = orig.z - cz[i];
+		const float p = dir.x * ocx + dir.y * ocy + dir.z * ocz;
+		const float lx = ocx - dir.x * p;
+		const float ly = ocy - dir.y * p;
+		const float lz = ocz - dir.z * p;
+		const float discriminant = r2[i] - (lx * lx + ly * ly + lz * lz);
+		if (discriminant < 0.0f)
+			return 0;
+		const float dist = -p - std::sqrt(discriminant);
+		return dist < 0 ? 0 : dist;
+	}
+};
+
+// One instruction set's build of the sphere tests
+struct Kernel
+{
+	util::Isa isa;
+	int width;
+	RayHit (*closest)(const Spheres&, const Vec3f&, const Vec3f&, float);
+	bool (*occluded)(const Spheres&, const Vec3f&, const Vec3f&, float);
+};
+
+namespace scalar
+{
+struct Lanes
+{
+	static constexpr int WIDTH = 1;
+	using F = float;
+	static F Set1(const float x) { return x; }
+	static F Load(const float* p) { return *p; }
+	static void Store(float* p, const F x) { *p = x; }
+	static F Add(const F a, const F b) { return a + b; }
+	static F Sub(const F a, const F b) { return a - b; }
+	static F Mul(const F a, const F b) { return a * b; }
+	static F Sqrt(const F x) { return std::sqrt(x); }
+	static int Hits(const F discriminant, const F t, const F tMax) { return discriminant >= 0 && t > 0 && t < tMax; }
+};
+#include "Accel/SphereKernel.inl"
+}
+
+// Lane types per instruction set: float vector F and the hit mask of a block
+#if defined(__x86_64__) || defined(__i386__)
+	#pragma GCC push_options
+	#pragma GCC target("sse2")
+namespace sse2
+{
+struct Lanes
+{
+	static constexpr int WIDTH = 4;
+	using F = __m128;
+	static F Set1(const float x) { return _mm_set1_ps(x); }
+	static F Load(const float* p) { return _mm_loadu_ps(p); }
+	static void Store(float* p, const F x) { _mm_storeu_ps(p, x); }
+	static F Add(const F a, const F b) { return _mm_add_ps(a, b); }
+	static F Sub(const F a, const F b) { return _mm_sub_ps(a, b); }
+	static F Mul(const F a, const F b) { return _mm_mul_ps(a, b); }
+	static F Sqrt(const F x) { return _mm_sqrt_ps(x); }
+	// discriminant >= 0 && 0 < t < tMax
+	static int Hits(const F discriminant, const F t, const F tMax)
+	{
+		const F valid = _mm_cmpge_ps(discriminant, _mm_setzero_ps());
+		const F inFront = _mm_and_ps(_mm_cmpgt_ps(t, _mm_setzero_ps()), _mm_cmplt_ps(t, tMax));
+		return _mm_movemask_ps(_mm_and_ps(valid, inFront));
+	}
+};
+	#include "Accel/SphereKernel.inl"
+}
+	#pragma GCC pop_options
+
+	#pragma GCC push_options
+	#pragma GCC target("avx2")
+namespace avx2
+{
+struct Lanes
+{
+	static constexpr int WIDTH = 8;
+	using F = __m256;
+	static F Set1(const float x) { return _mm256_set1_ps(x); }
+	static F Load(const float* p) { return _mm256_loadu_ps(p); }
+	static void Store(float* p, const F x) { _mm256_storeu_ps(p, x); }
+	static F Add(const F a, const F b) { return _mm256_add_ps(a, b); }
+	static F Sub(const F a, const F b) { return _mm256_sub_ps(a, b); }
+	static F Mul(const F a, const F b) { return _mm256_mul_ps(a, b); }
+	static F Sqrt(const F x) { return _mm256_sqrt_ps(x); }
+	static int Hits(const F discriminant, const F t, const F tMax)
+	{
+		const F valid = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ);
+		const F inFront = _mm256_and_ps(_mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_cmp_ps(t, tMax, _CMP_LT_OQ));
+		return _mm256_movemask_ps(_mm256_and_ps(valid, inFront));
+	}
+};
+	#include "Accel/SphereKernel.inl"
+}
+	#pragma GCC pop_options
+
+	#pragma GCC push_options
+	#pragma GCC target("avx512f")
+	// AVX-512 brings FMA along, fused multiply-adds would round differently from the other variants
+	#pragma GCC optimize("fp-contract=off")
+namespace avx512
+{
+struct Lanes
+{
+	static constexpr int WIDTH = 16;
+	using F = __m512;
+	static F Set1(const float x) { return _mm512_set1_ps(x); }
+	static F Load(const float* p) { return _mm512_loadu_ps(p); }
+	static void Store(float* p, const F x) { _mm512_storeu_ps(p, x); }
+	static F Add(const F a, const F b) { return _mm512_add_ps(a, b); }
+	static F Sub(const F a, const F b) { return _mm512_sub_ps(a, b); }
+	static F Mul(const F a, const F b) { return _mm512_mul_ps(a, b); }
+	// _mm512_sqrt_ps trips GCC's uninitialized warning on its undefined pass-through operand
+	static F Sqrt(const F x) { return _mm512_maskz_sqrt_ps(0xffff, x); }
+	static int Hits(const F discriminant, const F t, const F tMax)
+	{
+		const __mmask16 valid = _mm512_cmp_ps_mask(discriminant, _mm512_setzero_ps(), _CMP_GE_OQ);
+		return _mm512_mask_cmp_ps_mask(_mm512_mask_cmp_ps_mask(valid, t, _mm512_setzero_ps(), _CMP_GT_OQ), t, tMax, _CMP_LT_OQ);
+	}
+};
+	#include "Accel/SphereKernel.inl"
+}
+	#pragma GCC pop_options
+#elif defined(UTIL_NEON_VARIANTS)
+	#pragma GCC push_options
+	#if defined(__arm__)
+		#pragma GCC target("fpu=neon")
+	#endif
+namespace neon
+{
+struct Lanes
+{
+	static constexpr int WIDTH = 4;
+	using F = float32x4_t;
+	static F Set1(const float x) { return vdupq_n_f32(x); }
+	static F Load(const float* p) { return vld1q_f32(p); }
+	static void Store(float* p, const F x) { vst1q_f32(p, x); }
+	static F Add(const F a, const F b) { return vaddq_f32(a, b); }
+	static F Sub(const F a, const F b) { return vsubq_f32(a, b); }
+	static F Mul(const F a, const F b) { return vmulq_f32(a, b); }
+	static F Sqrt(F x)
+	{
+	#if defined(__aarch64__)
+		return vsqrtq_f32(x);
+	#else
+		// ARMv7 has no vector square root that rounds like the scalar one
+		float lanes[4];
+		vst1q_f32(lanes, x);
+		for (float& lane : lanes)
+		{
+			lane = std::sqrt(lane);
+		}
+		return vld1q_f32(lanes);
+	#endif
+	}
+	static int Hits(const F discriminant, const F t, const F tMax)
+	{
+		const uint32x4_t valid = vcgeq_f32(discriminant, vdupq_n_f32(0.0f));
+		const uint32x4_t inFront = vandq_u32(vcgtq_f32(t, vdupq_n_f32(0.0f)), vcltq_f32(t, tMax));
+		const uint32_t bits[4] = { 1, 2, 4, 8 };
+		const uint32x4_t mask = vandq_u32(vandq_u32(valid, inFront), vld1q_u32(bits));
+		const uint32x2_t pairs = vpadd_u32(vget_low_u32(mask), vget_high_u32(mask));
+		return (int)vget_lane_u32(vpadd_u32(pairs, pairs), 0);
+	}
+};
+	#include "Accel/SphereKernel.inl"
+}
+	#pragma GCC pop_options
+#endif
+
+// Every variant this build has, widest first
+inline const std::vector<Kernel>& Kernels()
+{
+	static const std::vector<Kernel> kernels {
+#if defined(__x86_64__) || defined(__i386__)
+		{ util::Isa::AVX512, avx512::Lanes::WIDTH, avx512::Closest, avx512::Occluded },
+		{ util::Isa::AVX2, avx2::Lanes::WIDTH, avx2::Closest, avx2::Occluded },
+		{ util::Isa::SSE2, sse2::Lanes::WIDTH, sse2::Closest, sse2::Occluded },
+#elif defined(UTIL_NEON_VARIANTS)
+		{ util::Isa::NEON, neon::Lanes::WIDTH, neon::Closest, neon::Occluded },
+#endif
+		{ util::Isa::Scalar, scalar::Lanes::WIDTH, scalar::Closest, scalar::Occluded }
+	};
+	return kernels;
+}
+
+// The widest variant the CPU runs, picked once
+inline const Kernel& BestKernel()
+{
+	static const Kernel& best = *std::find_if(Kernels().begin(), Kernels().end(), [](const Kernel& kernel) { return util::Supports(kernel.isa); });
+	return best;
+}
+}
+
+// Sphere centers and squared radii in separate arrays, the only fields the intersection
+// test reads. One ray is tested against a whole register of spheres at a time, the spheres
+// that don't fill a register go through the scalar test. Which registers is decided at
+// startup from the CPU, see soa::BestKernel.
+class SphereSoA
+{
+public:
+	explicit SphereSoA(const soa::Kernel& kernel = soa::BestKernel()) :
+		kernel(&kernel)
+	{}
+
+	// Called again whenever the spheres moved
+	void Build(const std::vector<Sphere>& spheres)
+	{
+		const size_t n = spheres.size();
+		cx.resize(n);
+		cy.resize(n);
+		cz.resize(n);
+		r2.resize(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			cx[i] = spheres[i].position.x;
+			cy[i] = spheres[i].position.y;
+			cz[i] = spheres[i].position.z;
+			r2[i] = spheres[i].radius * spheres[i].radius;
+		}
+	}
+
+	int Size() const
+	{
+		return (int)cx.size();
+	}
+
+	// Spheres tested at once
+	int Width() const
+	{
+		return kernel->width;
+	}
+
+	util::Isa Isa() const
+	{
+		return kernel->isa;
+	}
+
+	// Closest sphere hit before tMax, same distances as Sphere::HitDistance
+	RayHit Closest(const Vec3f& orig, const Vec3f& dir, const float tMax) const
+	{
+		return kernel->closest(Arrays(), orig, dir, tMax);
+	}
+
+	bool Occluded(const Vec3f& orig, const Vec3f& dir, const float maxDistance) const
+	{
+		return kernel->occluded(Arrays(), orig, dir, maxDistance);
+	}
+
+private:
+	soa::Spheres Arrays() const
+	{
+		return { cx.data(), cy.data(), cz.data(), r2.data(), Size() };
+	}
+
+	const soa::Kernel* kernel;
+	std::vector<float> cx, cy, cz, r2;
+};
+
+#endif // ACCEL_SPHERE_SOA_HPP
@@ -0,0 +1,323 @@
+#ifndef ACCEL_WIDE_BVH_HPP
+#define ACCEL_WIDE_BVH_HPP
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64)
+	#include <immintrin.h>
+#endif
+
+#include "Accel/BVH.hpp"
+#include "Utility/Cpu.hpp"
+
+// Child bounds are stored per axis so all children of a node are tested together
+template <int W>
+struct alignas(32) WideBVHNode
+{
+	float bounds[6][W]; // minX, minY, minZ, maxX, maxY, maxZ of every child
+	int child[W]; // Inner child: node index, leaf child: first index
+	int count[W]; // Spheres of a leaf child, 0 for inner children, -1 for empty slots
+};
+
+// Traversal variants per instruction set, see Accel/WideTraversal.inl
+namespace wide
+{
+namespace generic
+{
+// Returns a bit mask of the children hit before tMax, tNear gets their entry distances
+template <int W>
+inline int IntersectChildren(const WideBVHNode<W>& node, const Vec3f& orig, const Vec3f& invDir, const int* near, const float tMax, float* tNear)
+{
+#if defined(__SSE__) || defined(_M_X64)
+	{
+		const __m128 ox = _mm_set1_ps(orig.x);
+		const __m128 oy = _mm_set1_ps(orig.y);
+		const __m128 oz = _mm_set1_ps(orig.z);
+		const __m128 ix = _mm_set1_ps(invDir.x);
+		const __m128 iy = _mm_set1_ps(invDir.y);
+		const __m128 iz = _mm_set1_ps(invDir.z);
+		int mask = 0;
+		for (int i = 0; i < W; i += 4)
+		{
+			__m128 tn = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[near[0]] + i), ox), ix);
+			__m128 tf = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[3 - near[0]] + i), ox), ix);
+			tn = _mm_max_ps(tn, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[near[1]] + i), oy), iy));
+			tf = _mm_min_ps(tf, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[5 - near[1]] + i), oy), iy));
+			tn = _mm_max_ps(tn, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[near[2]] + i), oz), iz));
+			tf = _mm_min_ps(tf, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[7 - near[2]] + i), oz), iz));
+			tn = _mm_max_ps(tn, _mm_setzero_ps());
+			tf = _mm_min_ps(tf, _mm_set1_ps(tMax));
+			_mm_storeu_ps(tNear + i, tn);
+			mask |= _mm_movemask_ps(_mm_cmple_ps(tn, tf)) << i;
+		}
+		return mask;
+	}
+#else
+	int mask = 0;
+	for (int i = 0; i < W; i++)
+	{
+		float tn = (node.bounds[near[0]][i] - orig.x) * invDir.x;
+		float tf = (node.bounds[3 - near[0]][i] - orig.x) * invDir.x;
+		tn = std::max(tn, (node.bounds[near[1]][i] - orig.y) * invDir.y);
+		tf = std::min(tf, (node.bounds[5 - near[1]][i] - orig.y) * invDir.y);
+		tn = std::max(tn, (node.bounds[near[2]][i] - orig.z) * invDir.z);
+		tf = std::min(tf, (node.bounds[7 - near[2]][i] - orig.z) * invDir.z);
+		tn = std::max(tn, 0.0f);
+		tf = std::min(tf, tMax);
+		tNear[i] = tn;
+		mask |= (tn <= tf) << i;
+	}
+	return mask;
+#endif
+}
+#include "Accel/WideTraversal.inl"
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+	#pragma GCC push_options
+	#pragma GCC target("avx2")
+namespace avx2
+{
+// The eight children of a BVH8 node in one register, picked at runtime like the sphere kernels
+inline int IntersectChildren(const WideBVHNode<8>& node, const Vec3f& orig, const Vec3f& invDir, const int* near, const float tMax, float* tNear)
+{
+	const __m256 ox = _mm256_set1_ps(orig.x);
+	const __m256 oy = _mm256_set1_ps(orig.y);
+	const __m256 oz = _mm256_set1_ps(orig.z);
+	const __m256 ix = _mm256_set1_ps(invDir.x);
+	const __m256 iy = _mm256_set1_ps(invDir.y);
+	const __m256 iz = _mm256_set1_ps(invDir.z);
+	__m256 tn = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[near[0]]), ox), ix);
+	__m256 tf = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[3 - near[0]]), ox), ix);
+	tn = _mm256_max_ps(tn, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[near[1]]), oy), iy));
+	tf = _mm256_min_ps(tf, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[5 - near[1]]), oy), iy));
+	tn = _mm256_max_ps(tn, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[near[2]]), oz), iz));
+	tf = _mm256_min_ps(tf, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[7 - near[2]]), oz), iz));
+	tn = _mm256_max_ps(tn, _mm256_setzero_ps());
+	tf = _mm256_min_ps(tf, _mm256_set1_ps(tMax));
+	_mm256_storeu_ps(tNear, tn);
+	return _mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ));
+}
+	#include "Accel/WideTraversal.inl"
+}
+	#pragma GCC pop_options
+#endif
+}
+
+// Binary BVH collapsed into W-ary nodes (BVH4 / BVH8)
+template <int W>
+class WideBVH : public IAccelerator
+{
+	static_assert(W == 4 || W == 8, "WideBVH supports 4 and 8 children per node");
+
+public:
+	explicit WideBVH(util::Workers* buildWorkers = nullptr, const BVHBuilder builder = BVHBuilder::BinnedSAH) :
+		binary(buildWorkers, builder),
+		nodeIsa(NodeIsa())
+	{}
+
+	void Build(const std::vector<Sphere>& sphereList) final
+	{
+		spheres = &sphereList;
+		binary.Build(sphereList);
+		Collapse(binary, nodes);
+	}
+
+	// Refits (or rebuilds) the binary tree and collapses it again, which is linear
+	void Update(const std::vector<Sphere>& sphereList) final
+	{
+		spheres = &sphereList;
+		binary.Update(sphereList);
+		Collapse(binary, nodes);
+	}
+
+	RayHit Closest(const Vec3f& orig, const Vec3f& dir) const final
+	{
+		RayHit hit {};
+		float closest = std::numeric_limits<float>::max();
+		Traverse(orig, dir, closest, [&](const int prim) {
+			const float distance = (*spheres)[prim].HitDistance(orig, dir);
+			if (distance > 0 && distance < closest)
+			{
+				hit.distance = distance;
+				hit.prim = prim;
+				closest = distance;
+			}
+		});
+		return hit;
+	}
+
+	bool Occluded(const Vec3f& orig, const Vec3f& dir, const float maxDistance) const final
+	{
+		bool occluded = false;
+		float tMax = maxDistance;
+		Traverse(orig, dir, tMax, [&](const int prim) {
+			if (!occluded && (*spheres)[prim].Occludes(orig, dir, maxDistance))
+			{
+				occluded = true;
+				tMax = 0.0f;
+			}
+		});
+		return occluded;
+	}
+
+	// Same contract as BVH::Traverse
+	template <typename F>
+	void Traverse(const Vec3f& orig, const Vec3f& dir, float& closest, F&& intersect) const
+	{
+		if (nodes.empty())
+			return;
+
+		const Vec3f invDir = SafeInverse(dir);
+		float tEntry = 0;
+		if (!binary.Nodes()[0].bounds.Intersect(orig, invDir, closest, tEntry))
+			return;
+
+#if defined(__x86_64__) || defined(__i386__)
+		if constexpr (W == 8)
+		{
+			if (nodeIsa == util::Isa::AVX2)
+			{
+				wide::avx2::Traverse(nodes, binary.Indices(), orig, invDir, tEntry, closest, intersect);
+				return;
+			}
+		}
+#endif
+		wide::generic::Traverse(nodes, binary.Indices(), orig, invDir, tEntry, closest, intersect);
+	}
+
+	const char* Name() const final
+	{
+		return W == 4 ? "bvh4" : "bvh8";
+	}
+
+	// Instruction set the children of a node are tested with on this CPU
+	static util::Isa NodeIsa()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		if (W == 8 && util::Supports(util::Isa::AVX2))
+			return util::Isa::AVX2;
+#endif
+#if defined(__SSE__) || defined(_M_X64)
+		return util::Isa::SSE2;
+#else
+		return util::Isa::Scalar;
+#endif
+	}
+
+	const std::vector<WideBVHNode<W>>& Nodes() const
+	{
+		return nodes;
+	}
+
+	const BVH& Binary() const
+	{
+		return binary;
+	}
+
+	size_t MemoryBytes() const
+	{
+		return nodes.size() * sizeof(WideBVHNode<W>) + binary.Indices().size() * sizeof(int);
+	}
+
+	// Collapses the binary tree into W-ary nodes, the root ends up at index 0
+	static void Collapse(const BVH& binary, std::vector<WideBVHNode<W>>& nodes)
+	{
+		nodes.clear();
+		const auto& binaryNodes = binary.Nodes();
+		if (binaryNodes.empty())
+			return;
+
+		nodes.emplace_back();
+
+		// Pairs of binary node and the wide node it is collapsed into
+		std::vector<std::pair<int, int>> stack { { 0, 0 } };
+		while (!stack.empty())
+		{
+			const auto [binaryIndex, wideIndex] = stack.back();
+			stack.pop_back();
+
+			// Open up the largest inner children until the node is full
+			int gathered[W];
+			int numGathered = 0;
+			if (binaryNodes[binaryIndex].IsLeaf())
+			{
+				gathered[numGathered++] = binaryIndex;
+			}
+			else
+			{
+				gathered[numGathered++] = binaryNodes[binaryIndex].leftFirst;
+				gathered[numGathered++] = binaryNodes[binaryIndex].leftFirst + 1;
+			}
+			while (numGathered < W)
+			{
+				int best = -1;
+				float bestArea = -1.0f;
+				for (int i = 0; i < numGathered; i++)
+				{
+					const BVHNode& candidate = binaryNodes[gathered[i]];
+					if (!candidate.IsLeaf() && candidate.bounds.SurfaceArea() > bestArea)
+					{
+						best = i;
+						bestArea = candidate.bounds.SurfaceArea();
+					}
+				}
+				if (best < 0)
+					break;
+
+				const int opened = binaryNodes[gathered[best]].leftFirst;
+				gathered[best] = opened;
+				gathered[numGathered++] = opened + 1;
+			}
+
+			WideBVHNode<W> node {};
+			for (int i = 0; i < W; i++)
+			{
+				if (i >= numGathered)
+				{
+					// Inverted bounds are never hit since near and far planes are picked by direction sign
+					for (int axis = 0; axis < 3; axis++)
+					{
+						node.bounds[axis][i] = std::numeric_limits<float>::max();
+						node.bounds[axis + 3][i] = -std::numeric_limits<float>::max();
+					}
+					node.child[i] = 0;
+					node.count[i] = -1;
+					continue;
+				}
+
+				const BVHNode& source = binaryNodes[gathered[i]];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					node.bounds[axis][i] = source.bounds.min[axis];
+					node.bounds[axis + 3][i] = source.bounds.max[axis];
+				}
+				if (source.IsLeaf())
+				{
+					node.child[i] = source.leftFirst;
+					node.count[i] = source.count;
+				}
+				else
+				{
+					node.child[i] = (int)nodes.size();
+					node.count[i] = 0;
+					nodes.emplace_back();
+					stack.push_back({ gathered[i], node.child[i] });
+				}
+			}
+			nodes[wideIndex] = node;
+		}
+	}
+
+private:
+	BVH binary;
+	std::vector<WideBVHNode<W>> nodes;
+	util::Isa nodeIsa;
+};
+
+using BVH4 = WideBVH<4>;
+using BVH8 = WideBVH<8>;
+
+#endif // ACCEL_WIDE_BVH_HPP
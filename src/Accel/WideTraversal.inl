@@ -0,0 +1,55 @@
+// Traversal of WideBVH for one instruction set. Included by WideBVH.hpp once per instruction
+// set, inside a namespace that defines IntersectChildren and under the matching
+// #pragma GCC target, so the node test inlines into the loop.
+
+// Same contract as BVH::Traverse, for a ray that enters the root at tEntry
+template <int W, typename F>
+void Traverse(const std::vector<WideBVHNode<W>>& nodes, const std::vector<int>& indices, const Vec3f& orig, const Vec3f& invDir, const float tEntry, float& closest, F&& intersect)
+{
+	// Rows of the near and far planes depend on the direction sign
+	const int near[3] = { invDir.x < 0 ? 3 : 0, invDir.y < 0 ? 4 : 1, invDir.z < 0 ? 5 : 2 };
+
+	TraversalEntry stack[BVH::MAX_DEPTH * W];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, tEntry };
+	while (stackSize > 0)
+	{
+		const auto entry = stack[--stackSize];
+		if (entry.tEntry >= closest)
+			continue;
+
+		const WideBVHNode<W>& node = nodes[entry.node];
+		float tNear[W];
+		int mask = IntersectChildren(node, orig, invDir, near, closest, tNear);
+
+		// Leaves are intersected right away, inner children are pushed far to near
+		int order[W];
+		int numInner = 0;
+		while (mask)
+		{
+			const int i = __builtin_ctz(mask);
+			mask &= mask - 1;
+			if (node.count[i] > 0)
+			{
+				for (int j = node.child[i]; j < node.child[i] + node.count[i]; j++)
+				{
+					intersect(indices[j]);
+				}
+			}
+			else
+			{
+				int k = numInner++;
+				while (k > 0 && tNear[order[k - 1]] < tNear[i])
+				{
+					order[k] = order[k - 1];
+					k--;
+				}
+				order[k] = i;
+			}
+		}
+		for (int k = 0; k < numInner; k++)
+		{
+			stack[stackSize++] = { node.child[order[k]], tNear[order[k]] };
+		}
+	}
+}
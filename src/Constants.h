@@ -5,4 +5,30 @@ constexpr float SPEED = 2.0;
 constexpr int FOV = 60;
 
 constexpr int WINDOW_WIDTH = 1280;
-constexpr int WINDOW_HEIGHT = 720;
\ No newline at end of file
+constexpr int WINDOW_HEIGHT = 720;
+
+// Thread count when the CPU count can't be read, and the fixed count of the benchmarks
+constexpr int NUM_THREADS = 8;
+// The render threads take the frame in tiles of this many whole rows
+constexpr int TILE_ROWS = 8;
+
+// Scenes up to this size skip the acceleration structure
+constexpr int BRUTE_FORCE_MAX_SPHERES = 16;
+
+// Rays per packet for primary and shadow rays: one SIMD register wide. Wider packets
+// (up to 16) work too, but get split into slow generic code on narrower registers.
+#if defined(__AVX512F__)
+constexpr int PACKET_SIZE = 16;
+#elif defined(__AVX__)
+constexpr int PACKET_SIZE = 8;
+#else
+constexpr int PACKET_SIZE = 4;
+#endif
+
+// Hits beyond this distance count as misses
+constexpr float MAX_RAY_DISTANCE = 1000;
+// Reflections are followed up to this recursion depth (primary rays are depth 0)
+constexpr int MAX_REFLECTION_DEPTH = 5;
+
+// Shadow rays start this far above the surface so they don't hit it again
+constexpr float SHADOW_BIAS = 1e-3;
@@ -1,4 +1,9 @@
+#ifndef GEOMETRY_CPP
+#define GEOMETRY_CPP
+
+#include <cmath>
 #include <string>
+#include <utility>
 
 template <typename T>
 class Vec3
@@ -74,7 +79,7 @@ public:
 	}
 	T length() const
 	{
-		return sqrt(norm());
+		return std::sqrt(norm());
 	}
 
 	void normalize()
@@ -178,7 +183,74 @@ public:
 		dst.y = b;
 		dst.z = c;
 	}
+
+	Matrix44 operator*(const Matrix44& m) const
+	{
+		Matrix44 out;
+		for (uint8_t i = 0; i < 4; ++i)
+		{
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				out.x[i][j] = x[i][0] * m.x[0][j] + x[i][1] * m.x[1][j] + x[i][2] * m.x[2][j] + x[i][3] * m.x[3][j];
+			}
+		}
+		return out;
+	}
+
+	// Gauss-Jordan elimination with partial pivoting, singular matrices give the identity
+	Matrix44 inverse() const
+	{
+		Matrix44 s;
+		Matrix44 t(*this);
+
+		for (uint8_t i = 0; i < 4; ++i)
+		{
+			uint8_t pivot = i;
+			T pivotSize = std::abs(t.x[i][i]);
+			for (uint8_t j = i + 1; j < 4; ++j)
+			{
+				if (std::abs(t.x[j][i]) > pivotSize)
+				{
+					pivot = j;
+					pivotSize = std::abs(t.x[j][i]);
+				}
+			}
+			if (pivotSize == 0)
+				return Matrix44();
+
+			if (pivot != i)
+			{
+				for (uint8_t j = 0; j < 4; ++j)
+				{
+					std::swap(t.x[i][j], t.x[pivot][j]);
+					std::swap(s.x[i][j], s.x[pivot][j]);
+				}
+			}
+
+			const T f = t.x[i][i];
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				t.x[i][j] /= f;
+				s.x[i][j] /= f;
+			}
+
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				if (j == i)
+					continue;
+				const T g = t.x[j][i];
+				for (uint8_t k = 0; k < 4; ++k)
+				{
+					t.x[j][k] -= g * t.x[i][k];
+					s.x[j][k] -= g * s.x[i][k];
+				}
+			}
+		}
+		return s;
+	}
 };
 
 using Matrix44f = Matrix44<float>;
 using Matrix44i = Matrix44<int>;
+
+#endif // GEOMETRY_CPP
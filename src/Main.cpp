@@ -2,152 +2,88 @@
 
 #include "Platform/Platform.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <ctime>
 #include <iostream>
 #include <memory>
-#include <mutex>
 #include <sys/time.h>
 #include <thread>
 #include <time.h>
 #include <vector>
 
+#include "Accel/Accelerator.hpp"
+#include "Accel/Instancing.hpp"
 #include "Constants.h"
 #include "Geometry.cpp"
+#include "Render/Accumulation.hpp"
+#include "Render/FramePipeline.hpp"
+#include "Render/Framebuffer.hpp"
+#include "Render/Wavefront.hpp"
+#include "Scene.hpp"
+#include "Utility/DoubleBuffer.hpp"
+#include "Utility/FirstTouchArray.hpp"
+#include "Utility/TaskGraph.hpp"
+#include "Utility/ThreadPool.hpp"
+#include "Utility/Topology.hpp"
 
-// Setup scene
-struct Color
+template <typename T>
+T clip(const T& n, const T& lower, const T& upper)
 {
-	int r, g, b;
-	Color() :
-		r(0),
-		g(0),
-		b(0)
-	{}
-	Color(const Color& col) :
-		r(col.r),
-		g(col.g),
-		b(col.b)
-	{}
-	Color(int re, int gr, int bl) :
-		r(re),
-		g(gr),
-		b(bl)
-	{}
-	void operator+=(const Color& col)
-	{
-		r = std::min(255, col.r + r);
-		g = std::min(255, col.g + g);
-		b = std::min(255, col.b + b);
-	}
-	Color operator*(const float f) const
-	{
-		int rr = std::min(255, (int)(r * f));
-		int gg = std::min(255, (int)(g * f));
-		int bb = std::min(255, (int)(b * f));
-		return Color(rr, gg, bb);
-	}
-	void operator*=(const float f)
-	{
-		r = std::min(255, (int)(r * f));
-		g = std::min(255, (int)(g * f));
-		b = std::min(255, (int)(b * f));
-	}
-};
+	return std::max(lower, std::min(n, upper));
+}
 
-struct Light
+// Where a frame's time went, each part measured on the thread that did it
+struct FrameStats
 {
-	Vec3f position {};
-	float brightness;
-
-	Light(const Vec3f pos, const float bright) :
-		position(pos),
-		brightness(bright)
-	{}
+	const char* scene = "";
+	float updateMs = 0; // Simulating the frame's snapshot, buildMs of it building its scene
+	float buildMs = 0;
+	float traceMs = 0;
+	float resolveMs = 0; // Accumulation and tonemap
+	float stallMs = 0; // Tracing waiting for a free frame
+	float waitMs = 0; // Showing waiting for a traced frame
+	float uploadMs = 0;
+	float presentMs = 0;
+	std::array<BounceStats, Wavefront::MAX_BOUNCES> bounces {};
+	size_t historyBytes = 0;
+
+	void operator+=(const FrameStats& other)
+	{
+		updateMs += other.updateMs;
+		buildMs += other.buildMs;
+		traceMs += other.traceMs;
+		resolveMs += other.resolveMs;
+		stallMs += other.stallMs;
+		waitMs += other.waitMs;
+		uploadMs += other.uploadMs;
+		presentMs += other.presentMs;
+	}
 };
 
-struct Collision
+// The world as one simulation step left it, with the structure rays are traced against. Frames
+// trace a published snapshot while the next step is simulated into the other one.
+struct SceneSnapshot
 {
-	Vec3f position;
-	Vec3f reflection;
-	Vec3f normal;
-	Color color;
-	float distance = 0;
+	std::vector<Sphere> spheres;
+	std::unique_ptr<IAccelerator> accelerator;
+	std::vector<Instance> instances;
+	TwoLevelBVH instancedScene;
+	// The accelerator or the instanced scene
+	const IRayQuery* scene = nullptr;
+	float updateMs = 0;
+	float buildMs = 0;
 };
 
-struct Sphere
+// A finished frame on its way to the screen
+struct PipelinedFrame
 {
-	Vec3f position {};
-	float radius {};
-	Color color {};
-	Vec3f velocity {};
-	bool forward = true;
-
-	Sphere(const Vec3f pos, const float rad, const Color col, const Vec3f vel) :
-		position(pos),
-		radius(rad),
-		color(col),
-		velocity(vel)
-	{}
-
-	Collision RayIntersection(
-		const Vec3f& orig,
-		const Vec3f& direction) const
-	{
-		const auto o_minus_c = orig - position;
-
-		const auto p = direction.dotProduct(o_minus_c);
-		const auto q = o_minus_c.dotProduct(o_minus_c) - (radius * radius);
-
-		const auto discriminant = (p * p) - q;
-
-		Collision hit {};
-
-		if (discriminant < 0.0f)
-		{
-			return hit;
-		}
-
-		const auto dRoot = sqrt(discriminant);
-		// auto dist = std::min(-p - dRoot, -p + dRoot);
-		const auto dist = -p - dRoot;
-		if (dist < 0)
-		{
-			return hit;
-		}
-
-		// Calc hit position and reflection
-		hit.position = orig + direction * dist;
-		hit.normal = hit.position - position;
-		hit.normal.normalize();
-		hit.reflection = direction - hit.normal * 2 * direction.dotProduct(hit.normal);
-		hit.color = color;
-		hit.distance = dist;
-
-		return hit;
-	}
-
-	void Update(const float dT)
-	{
-		if (forward)
-			position += velocity * dT;
-		else
-			position -= velocity * dT;
-	}
-
-	void ToggleDirection()
-	{
-		forward = !forward;
-	}
+	std::vector<sf::Uint8> pixels;
+	FrameStats stats;
 };
 
-template <typename T>
-T clip(const T& n, const T& lower, const T& upper)
-{
-	return std::max(lower, std::min(n, upper));
-}
-
 // Raytracer (actually more like a everything class...)
 class Raytracer
 {
@@ -158,25 +94,105 @@ public:
 	Matrix44f cameraToWorld {};
 	Vec3f orig = Vec3f(0);
 
-	// Level (should probably be refactored into separate level class)
+	// Level (should probably be refactored into separate level class). Only Update changes it,
+	// frames see it through the snapshots.
 	std::vector<Sphere> spheres;
 	std::vector<Light> lights;
 
+	// Closest hit queries over the spheres of every snapshot
+	AccelType accelType;
+
+	// Instanced level: copies of one shared sphere cluster, spinning in place. The transform
+	// is rebuilt from the pose every step so rounding doesn't pile up in the matrix.
+	struct InstancePose
+	{
+		Vec3f position;
+		float angle;
+		float scale;
+		float spin; // Radians per second
+	};
+	std::vector<Instance> instances;
+	std::vector<InstancePose> instancePoses;
+
+	// Update publishes a new snapshot every step, a frame takes the newest one and keeps it
+	util::DoubleBuffer<SceneSnapshot> snapshots;
+	uint64_t steps = 0;
+
+	// What castRay traces against: the frame's snapshot
+	const IRayQuery* scene = nullptr;
+	// Lights blocked by other spheres don't contribute
+	bool shadows = true;
+	// Primary and shadow rays are traced in packets of PACKET_SIZE rays where the scene supports it
+	bool packets = true;
+	// Rays are traced bounce by bounce as streams instead of recursively per pixel
+	bool wavefront = false;
+	// The wavefront reorders reflection rays for coherence before tracing them
+	bool sortRays = true;
+	// One wavefront per render thread, and their per-bounce costs of the last frame
+	std::vector<Wavefront> wavefronts;
+	std::array<BounceStats, Wavefront::MAX_BOUNCES> bounceStats;
+
+	// The frame is cut into tiles of TILE_ROWS rows. Every render thread owns a block of
+	// them: it touches their directions and radiance first, so on NUMA machines they sit on
+	// its node, and renders them first before helping the others with theirs.
+	static constexpr int NUM_TILES = (WINDOW_HEIGHT + TILE_ROWS - 1) / TILE_ROWS;
+	struct alignas(64) TileCursor
+	{
+		std::atomic<int> next { 0 };
+		int end = 0;
+	};
+	std::vector<TileCursor> tileCursors;
+
 	// Ray directions are cached bc only a change in camera pos/rot will change them
-	std::vector<Vec3f> directions;
+	util::FirstTouchArray<Vec3f> directions;
+
+	// Radiance of the frame, tonemapped into its pixels once it is done. Starts on a cache line,
+	// like every tile in it, so the render threads write their tiles without sharing lines.
+	util::FirstTouchArray<Color> hdrBuffer;
+	framebuffer::Tonemap tonemap;
+	// Frames are averaged into a history before the tonemap, with jittered camera rays
+	bool accumulate = false;
+	Accumulator accumulator;
 
-	// Pixel output and associated mutex
-	std::vector<sf::Uint8> pixelBuffer;
+	// Pixel output
 	sf::Texture texture;
 	sf::RectangleShape sprite;
-	std::mutex pixelMutex;
+
+	// Render threads, started once and woken every frame
+	util::ThreadPool renderPool;
+
+	// ProduceFrame's stages as tasks on the render threads, see buildFrameGraph. The BVHs build
+	// on it too, so no stage starts threads of its own.
+	util::TaskGraph frameGraph;
+	util::TaskGraph::Task traceTask = 0;
+	util::TaskGraph::Task resolveTask = 0;
+	// What the frame graph is working on
+	PipelinedFrame* graphFrame = nullptr;
+	uint64_t graphIndex = 0;
+	const SceneSnapshot* graphSnapshot = nullptr;
 
 	// Gameloop stuff
 	time_t lastTick;
 
-	Raytracer() :
-		pixelBuffer(WINDOW_WIDTH * WINDOW_HEIGHT * 4)
+	// numThreads render threads, kept on one CPU each with pinThreads
+	Raytracer(const int numSpheres = 8, const AccelType accelType = AccelType::Auto, const int numInstances = 0,
+		const int numThreads = util::CoreCount(), const bool pinThreads = false) :
+		accelType(accelType),
+		tileCursors(std::max(1, numThreads)),
+		directions(WINDOW_WIDTH * WINDOW_HEIGHT),
+		hdrBuffer(WINDOW_WIDTH * WINDOW_HEIGHT),
+		renderPool(numThreads, pinThreads ? util::AllowedCpus() : std::vector<int> {}),
+		frameGraph(renderPool)
 	{
+		// Thread 0 is this thread here and the frame pipeline's later, with pinThreads the pool
+		// keeps both on the first CPU, so its block is touched where it is traced
+		renderPool.Run([this](const int thread) {
+			const int first = firstPixel(firstTile(thread));
+			const int count = firstPixel(firstTile(thread + 1)) - first;
+			directions.Touch(first, count);
+			hdrBuffer.Touch(first, count);
+		});
+
 		struct timeval time_now
 		{};
 		gettimeofday(&time_now, nullptr);
@@ -187,31 +203,21 @@ public:
 		sprite.setSize({ WINDOW_WIDTH, WINDOW_HEIGHT });
 		sprite.setTexture(&texture);
 
-		// No transparency
-		for (int i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++)
+		if (numInstances > 0)
 		{
-			pixelBuffer[i * 4 + 3] = 255;
+			GenerateInstancedLevel(numSpheres, numInstances, accelType);
 		}
-
-		GenerateLevel();
+		else
+		{
+			GenerateLevel(numSpheres);
+		}
+		Update();
+		buildFrameGraph();
 	}
 
-	void GenerateLevel()
+	void GenerateLevel(const int numSpheres)
 	{
-		for (int i = 0; i < 8; i++)
-		{
-			const auto pos = Vec3f(
-				-5.0 + (10.0 * ((rand() % 1000) / 1000.0)),
-				-3.0 + (6.0 * ((rand() % 1000) / 1000.0)),
-				-10.0 - 20.0 * ((rand() % 1000) / 1000));
-
-			auto vel = Vec3f((rand() % 1000), (rand() % 1000), (rand() % 1000));
-			vel /= 2000.0;
-
-			const auto col = Color(rand() % 255, rand() % 255, rand() % 255);
-			auto s1 = Sphere(pos, 0.5 + (rand() % 1000) / 1000.0, col, vel);
-			spheres.push_back(s1);
-		}
+		spheres = GenerateSpheres(numSpheres);
 
 		for (int i = 0; i < 2; i++)
 		{
@@ -227,122 +233,316 @@ public:
 		}
 	}
 
-	// Use when camera position is updated
-	void UpdateRayDirections()
+	// One cluster of numSpheres spheres shared by numInstances instances
+	void GenerateInstancedLevel(const int numSpheres, const int numInstances, const AccelType clusterAccelType)
+	{
+		GenerateLevel(0);
+		const auto cluster = std::make_shared<const BottomLevel>(GenerateCluster(numSpheres), clusterAccelType, &frameGraph);
+		for (int i = 0; i < numInstances; i++)
+		{
+			const auto pos = Vec3f(
+				-8.0 + (16.0 * ((rand() % 1000) / 1000.0)),
+				-4.0 + (8.0 * ((rand() % 1000) / 1000.0)),
+				-12.0 - 30.0 * ((rand() % 1000) / 1000.0));
+			const float angle = 2 * PI * ((rand() % 1000) / 1000.0);
+			const float scale = 0.5 + (rand() % 1000) / 1000.0;
+			const float spin = -1.0 + 2.0 * ((rand() % 1000) / 1000.0);
+			instances.push_back(Instance(cluster, InstanceTransform(pos, angle, scale)));
+			instancePoses.push_back({ pos, angle, scale, spin });
+		}
+	}
+
+	// Use when camera position is updated, jitter moves the rays within their pixels
+	void UpdateRayDirections(const float jitterX = 0.5f, const float jitterY = 0.5f)
 	{
 		cameraToWorld.multVecMatrix(Vec3f(0), orig);
-		for (uint32_t j = 0; j < WINDOW_HEIGHT; ++j)
+		// Every thread fills in the rows of its own tiles
+		renderPool.Run([&](const int thread) { updateRayRows(thread, jitterX, jitterY); });
+	};
+
+	// The directions of the rows in the tiles thread owns
+	void updateRayRows(const int thread, const float jitterX, const float jitterY)
+	{
+		for (int j = firstTile(thread) * TILE_ROWS; j < std::min(firstTile(thread + 1) * TILE_ROWS, WINDOW_HEIGHT); ++j)
 		{
 			for (uint32_t i = 0; i < WINDOW_WIDTH; ++i)
 			{
-				const float x = (2 * (i + 0.5) / (float)WINDOW_WIDTH - 1) * aspectRatio * scale;
-				const float y = (1 - 2 * (j + 0.5) / (float)WINDOW_HEIGHT) * scale;
+				const float x = (2 * (i + (double)jitterX) / (float)WINDOW_WIDTH - 1) * aspectRatio * scale;
+				const float y = (1 - 2 * (j + (double)jitterY) / (float)WINDOW_HEIGHT) * scale;
 				Vec3f dir {};
 				cameraToWorld.multDirMatrix(Vec3f(x, y, -1), dir);
 				dir.normalize();
-				directions.push_back(dir);
+				directions[j * WINDOW_WIDTH + i] = dir;
 			}
 		}
-	};
+	}
+
+	// The tiles thread owns start here and end where the next thread's start
+	int firstTile(const int thread) const
+	{
+		return NUM_TILES * thread / renderPool.Size();
+	}
+
+	// First pixel of a tile, the last tile takes whatever rows are left
+	static int firstPixel(const int tile)
+	{
+		return std::min(tile * TILE_ROWS, WINDOW_HEIGHT) * WINDOW_WIDTH;
+	}
 
 	Color castRay(const Vec3f& orig,
 		const Vec3f& dir,
 		const int depth)
 
 	{
-		Collision hit {};
-		float dist = 1e6;
+		const auto hit = scene->Intersect(orig, dir);
+		const float dist = hit.distance;
+		if (!(dist > 0 && dist < MAX_RAY_DISTANCE))
+			return Color {};
+
+		// Lights blocked by other spheres
+		uint32_t blocked = 0;
+		for (int i = 0; shadows && i < (int)lights.size(); i++)
+		{
+			Vec3f path {};
+			const float lightDistance = LightPath(hit, lights[i], path);
+			if (scene->Occluded(hit.position + hit.normal * SHADOW_BIAS, path * -1.0f, lightDistance))
+				blocked |= 1u << i;
+		}
+		return illuminate(hit, blocked, depth);
+	};
+
+	// Color of a hit lit by every light not in blocked, plus its reflection
+	Color illuminate(const Collision& hit, const uint32_t blocked, const int depth)
+	{
+		// Check illumination
+		Color out_color = DirectLight(hit, lights, blocked);
 
-		for (int i = 0; i < (int)spheres.size(); i++)
+		if (depth < MAX_REFLECTION_DEPTH)
 		{
-			const auto c_hit = spheres[i].RayIntersection(orig, dir);
-			if (c_hit.distance > 0 && c_hit.distance < dist)
-			{
-				hit = c_hit;
-				dist = c_hit.distance;
-			}
+			auto extra_color = castRay(hit.position, hit.reflection, depth + 1);
+			extra_color *= std::pow(0.6, depth + 1);
+			out_color += extra_color;
 		}
+		return out_color;
+	}
 
-		Color out_color {};
+	// Up to PACKET_SIZE primary rays traced as one packet, their shadow rays towards each light
+	// as one packet per light. Reflections diverge and are traced one by one.
+	void castPacket(const Vec3f& orig, const Vec3f* dirs, const int count, Color* colors)
+	{
+		Packet packet;
+		for (int i = 0; i < count; i++)
+		{
+			packet.Set(i, orig, dirs[i], MAX_RAY_DISTANCE);
+		}
+		RayHit hits[PACKET_SIZE];
+		scene->ClosestPacket(packet, hits);
 
-		if (dist > 0 && dist < 1000)
+		Collision collisions[PACKET_SIZE];
+		uint32_t hitMask = 0;
+		for (int i = 0; i < count; i++)
 		{
-			// Check illumination
-			const int num = (int)lights.size();
-			for (int i = 0; i < num; i++)
+			if (hits[i].distance > 0)
 			{
-				auto path = hit.position - lights[i].position;
-				path.normalize();
-				hit.color *= (acos(path.dotProduct(hit.normal)) / PI) * lights[i].brightness;
-				out_color += hit.color;
-			};
+				collisions[i] = scene->Shade(orig, dirs[i], hits[i]);
+				hitMask |= 1u << i;
+			}
+		}
 
-			if (depth < 5)
+		uint32_t blocked[PACKET_SIZE] = {};
+		for (int light = 0; shadows && hitMask && light < (int)lights.size(); light++)
+		{
+			Packet shadowRays;
+			for (int i = 0; i < count; i++)
 			{
-				auto extra_color = castRay(hit.position, hit.reflection, depth + 1);
-				extra_color *= std::pow(0.6, depth + 1);
-				out_color += extra_color;
+				if (!((hitMask >> i) & 1))
+					continue;
+				Vec3f path {};
+				const float lightDistance = LightPath(collisions[i], lights[light], path);
+				shadowRays.Set(i, collisions[i].position + collisions[i].normal * SHADOW_BIAS, path * -1.0f, lightDistance);
+			}
+			const uint32_t occluded = scene->OccludedPacket(shadowRays);
+			for (int i = 0; i < count; i++)
+			{
+				blocked[i] |= ((occluded >> i) & 1) << light;
 			}
 		}
-		return out_color;
-	};
 
-	void RenderSingleThread(sf::RenderTarget& target)
-	{
-		for (int i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++)
+		for (int i = 0; i < count; i++)
 		{
-			// Cast ray
-			auto bright = castRay(orig, directions[i], 0);
-
-			auto* ptr = &pixelBuffer.at(i * 4);
-			ptr[0] = bright.r;
-			ptr[1] = bright.g;
-			ptr[2] = bright.b;
+			colors[i] = (hitMask >> i) & 1 ? illuminate(collisions[i], blocked[i], 0) : Color {};
 		}
+	}
 
-		texture.update(pixelBuffer.data());
-		target.draw(sprite);
-	};
-
-	void RenderMultiThread(sf::RenderTarget& target, int numThreads = 8)
+	// Traces count pixels starting at first, out gets their radiance
+	void tracePixels(const int first, const int count, Color* out)
 	{
-		int portion = (WINDOW_WIDTH * WINDOW_HEIGHT) / numThreads;
-		std::vector<std::thread> workers;
-
-		for (int i = 0; i < numThreads; i++)
+		const bool tracePackets = packets && scene->TracesPackets();
+		for (int i = 0; i < count; i += PACKET_SIZE)
 		{
-			workers.push_back(std::thread([&](int iLocal) {
-				std::vector<sf::Uint8> partialBuffer(portion * 4);
-				for (int j = 0; j < portion; j++)
+			const int n = std::min(PACKET_SIZE, count - i);
+			if (tracePackets)
+			{
+				castPacket(orig, &directions[first + i], n, out + i);
+			}
+			else
+			{
+				for (int j = 0; j < n; j++)
 				{
-					// Cast rays
-					auto color = castRay(orig, directions[j + iLocal * portion], 0);
-					const int indLocal = j * 4;
-					partialBuffer[indLocal] = color.r;
-					partialBuffer[indLocal + 1] = color.g;
-					partialBuffer[indLocal + 2] = color.b;
-					partialBuffer[indLocal + 3] = 255;
+					out[i + j] = castRay(orig, directions[first + i + j], 0);
 				}
+			}
+		}
+	}
 
-				// Need mutex to copy into "global" pixelBuffer
-				pixelMutex.lock();
-				std::copy(partialBuffer.begin(), partialBuffer.end(), pixelBuffer.begin() + (iLocal * portion * 4));
-				pixelMutex.unlock();
-			},
-				i));
+	// Renders count pixels starting at first into out with the chosen method, thread picks the wavefront
+	void renderPixels(const int thread, const int first, const int count, Color* out)
+	{
+		if (!wavefront)
+		{
+			tracePixels(first, count, out);
+			return;
 		}
+		Wavefront& stream = wavefronts[thread];
+		stream.shadows = shadows;
+		stream.packets = packets;
+		stream.sortRays = sortRays;
+		stream.Render(*scene, lights, orig, &directions[first], count, out);
+	}
 
-		for (auto& worker : workers)
+	// Adds up what every thread's wavefront spent per bounce and clears them for the next frame
+	void gatherBounceStats(const int numThreads)
+	{
+		bounceStats = {};
+		for (int i = 0; wavefront && i < numThreads; i++)
+		{
+			for (int b = 0; b < Wavefront::MAX_BOUNCES; b++)
+			{
+				bounceStats[b] += wavefronts[i].stats[b];
+			}
+			wavefronts[i].stats = {};
+		}
+	}
+
+	// Points the frame at snapshot and gives every thread its own tiles back
+	void startTrace(const SceneSnapshot& snapshot)
+	{
+		scene = snapshot.scene;
+		const int numThreads = renderPool.Size();
+		wavefronts.resize(std::max<size_t>(wavefronts.size(), numThreads));
+		for (int t = 0; t < numThreads; t++)
+		{
+			tileCursors[t].next = firstTile(t);
+			tileCursors[t].end = firstTile(t + 1);
+		}
+	}
+
+	// Threads render their own tiles, then take the next tiles of the threads after them until
+	// none are left, so the ones whose tiles are cheap simply render more. A tile belongs to the
+	// one thread that took it, which writes it straight into hdrBuffer.
+	void traceTiles(const int iLocal)
+	{
+		static_assert(TILE_ROWS * WINDOW_WIDTH * sizeof(Color) % 64 == 0, "Tiles have to start on a cache line");
+		const int numThreads = renderPool.Size();
+		for (int k = 0; k < numThreads; k++)
 		{
-			worker.join();
+			TileCursor& cursor = tileCursors[(iLocal + k) % numThreads];
+			for (int tile = cursor.next++; tile < cursor.end; tile = cursor.next++)
+			{
+				// Cast rays
+				const int first = firstPixel(tile);
+				renderPixels(iLocal, first, firstPixel(tile + 1) - first, hdrBuffer.data() + first);
+			}
 		}
+	}
+
+	// Averages the traced frame in when accumulating, then tonemaps it into pixels
+	void resolveFrame(sf::Uint8* pixels)
+	{
+		if (accumulate)
+			accumulator.Add(hdrBuffer.data(), WINDOW_WIDTH * WINDOW_HEIGHT);
+		framebuffer::ToRGBA(hdrBuffer.data(), WINDOW_WIDTH * WINDOW_HEIGHT, tonemap, pixels);
+	}
+
+	// Everything one pipelined frame needs before it can go to the screen, on the frame graph
+	void ProduceFrame(PipelinedFrame& frame, const uint64_t index)
+	{
+		frame.stats = {};
+		graphFrame = &frame;
+		graphIndex = index;
+		frameGraph.Run();
+
+		FrameStats& stats = frame.stats;
+		stats.traceMs = frameGraph.Ms(traceTask);
+		stats.bounces = bounceStats;
+		stats.resolveMs = frameGraph.Ms(resolveTask);
+		stats.historyBytes = accumulator.Bytes();
+	}
 
-		texture.update(pixelBuffer.data());
+	// ProduceFrame's stages and what they wait for. The jittered rays and the newest snapshot
+	// come first, then the next step of the world is simulated and built while this one is
+	// traced, and the traced frame is resolved. A new stage is one more task, not one more thread.
+	void buildFrameGraph()
+	{
+		const int numThreads = renderPool.Size();
+		const auto rays = frameGraph.Add("rays", numThreads, [this](const int block, int) {
+			if (accumulate)
+				updateRayRows(block, accumulation::Halton(graphIndex, 2), accumulation::Halton(graphIndex, 3));
+		});
+		const auto snapshot = frameGraph.Add("snapshot", [this]() {
+			graphSnapshot = snapshots.Acquire();
+			FrameStats& stats = graphFrame->stats;
+			stats.scene = graphSnapshot->scene->Name();
+			stats.updateMs = graphSnapshot->updateMs;
+			stats.buildMs = graphSnapshot->buildMs;
+			startTrace(*graphSnapshot);
+		});
+		// Before the trace, so the first thread free takes them and the others trace meanwhile.
+		// The copy they fill was let go by the last frame's resolve, Simulate doesn't wait for it.
+		// The build's loops get the threads that are done tracing.
+		const auto simulate = frameGraph.Add("simulate", [this]() { Simulate(); }, { snapshot });
+		frameGraph.Add("build", [this]() { BuildSnapshot(); }, { simulate });
+		// By thread, not part, so every thread starts on the tiles it touched first. A thread only
+		// takes a second part once every tile is taken, its scratch is never shared.
+		traceTask = frameGraph.Add("trace", numThreads, [this](int, const int thread) { traceTiles(thread); }, { rays, snapshot });
+		const auto resolve = [this]() {
+			snapshots.Release(graphSnapshot);
+			gatherBounceStats(renderPool.Size());
+			graphFrame->pixels.resize(WINDOW_WIDTH * WINDOW_HEIGHT * 4);
+			resolveFrame(graphFrame->pixels.data());
+		};
+		resolveTask = frameGraph.Add("resolve", resolve, { traceTask });
+	}
+
+	static float msSince(const std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Uploads pixels to the texture and draws it, on the thread that owns the window
+	void drawFrame(sf::RenderTarget& target, const sf::Uint8* pixels)
+	{
+		texture.update(pixels);
 		target.draw(sprite);
-	};
+	}
 
+	// One simulation step: moves the world and publishes it as a new snapshot. Filling the
+	// unpublished snapshot waits until no frame still traces it (DoubleBuffer::Back).
 	void Update()
 	{
+		Simulate();
+		BuildSnapshot();
+	}
+
+	// Moves the world and copies it into the snapshot that is published next
+	void Simulate()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		if (steps++ % 200 == 0)
+		{
+			ToggleSphereDirections();
+		}
+
 		struct timeval time_now
 		{};
 		gettimeofday(&time_now, nullptr);
@@ -353,6 +553,49 @@ public:
 		{
 			sphere.Update(dT);
 		}
+
+		// Spinning instances only rebuild the top level, their cluster stays untouched
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			InstancePose& pose = instancePoses[i];
+			pose.angle = std::fmod(pose.angle + pose.spin * dT, 2 * PI);
+			instances[i].SetTransform(InstanceTransform(pose.position, pose.angle, pose.scale));
+		}
+
+		// The snapshot keeps its own copy, its structure points into it
+		SceneSnapshot& next = snapshots.Back();
+		if (instances.empty())
+			next.spheres = spheres;
+		else
+			next.instances = instances;
+		next.updateMs = msSince(start);
+	}
+
+	// Builds or refits the structure of the next snapshot over its copy and publishes it
+	void BuildSnapshot()
+	{
+		SceneSnapshot& next = snapshots.Back();
+		const auto start = std::chrono::steady_clock::now();
+		if (instances.empty())
+		{
+			if (next.accelerator)
+			{
+				next.accelerator->Update(next.spheres);
+			}
+			else
+			{
+				next.accelerator = CreateAccelerator(accelType, (int)next.spheres.size(), &frameGraph);
+				next.accelerator->Build(next.spheres);
+			}
+			next.scene = next.accelerator.get();
+		}
+		else
+		{
+			next.instancedScene.Build(next.instances);
+			next.scene = &next.instancedScene;
+		}
+		next.buildMs = msSince(start);
+		snapshots.Publish();
 	};
 
 	void ToggleSphereDirections()
@@ -365,14 +608,84 @@ public:
 };
 
 // Run it
-int main()
+// Usage: [--spheres <count>] [--accel <auto|brute|bvh|lbvh|bvh4|bvh8|qbvh|qbvh16|grid|hashgrid>] [--instances <count>]
+//        [--shadows <on|off>] [--packets <on|off>] [--wavefront <on|off>] [--sort <on|off>]
+//        [--accumulate <off|fp32|fp16>] [--history <frames>] [--threads <count>] [--pin <on|off>]
+//        [--queue <depth>]
+// Threads default to the CPUs this process may use, capped by its cgroup CPU quota
+// With instances, --spheres and --accel describe the cluster every instance shares
+int main(int argc, char* argv[])
 {
+	int numSpheres = 8;
+	AccelType accelType = AccelType::Auto;
+	int numInstances = 0;
+	bool shadows = true;
+	bool packets = true;
+	bool wavefront = false;
+	bool sortRays = true;
+	bool accumulate = false;
+	accumulation::Precision precision = accumulation::Precision::Float;
+	// The spheres keep moving, so the history only spans the last few frames
+	int historyFrames = 16;
+	int numThreads = util::CoreCount();
+	bool pinThreads = false;
+	// Frames in flight: 2 traces the next frame while this one is shown
+	int queueDepth = 2;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--spheres")
+			numSpheres = std::max(1, atoi(argv[i + 1]));
+		else if (arg == "--accel")
+			accelType = ParseAccelType(argv[i + 1]);
+		else if (arg == "--instances")
+			numInstances = std::max(0, atoi(argv[i + 1]));
+		else if (arg == "--shadows")
+			shadows = std::string(argv[i + 1]) != "off";
+		else if (arg == "--packets")
+			packets = std::string(argv[i + 1]) != "off";
+		else if (arg == "--wavefront")
+			wavefront = std::string(argv[i + 1]) == "on";
+		else if (arg == "--sort")
+			sortRays = std::string(argv[i + 1]) != "off";
+		else if (arg == "--accumulate")
+		{
+			accumulate = std::string(argv[i + 1]) != "off";
+			precision = std::string(argv[i + 1]) == "fp16" ? accumulation::Precision::Half : accumulation::Precision::Float;
+		}
+		else if (arg == "--history")
+			historyFrames = std::max(0, atoi(argv[i + 1]));
+		else if (arg == "--threads")
+			numThreads = std::max(1, atoi(argv[i + 1]));
+		else if (arg == "--pin")
+			pinThreads = std::string(argv[i + 1]) == "on";
+		else if (arg == "--queue")
+			queueDepth = std::max(1, atoi(argv[i + 1]));
+	}
+
+	// One binary runs everywhere, the SIMD kernels are picked for this CPU. Ray packets are as
+	// wide as the build targets, the other traversals don't depend on the CPU.
+	std::cout << "CPU: " << util::IsaName(util::CpuIsa()) << ", brute force kernel: " << util::IsaName(soa::BestKernel().isa)
+			  << ", bvh8 nodes: " << util::IsaName(BVH8::NodeIsa()) << ", tonemap: " << util::IsaName(framebuffer::BestConversion().isa)
+			  << ", fp16 blend: " << util::IsaName(accumulation::BestBlend().isa) << std::endl;
+	std::cout << "Ray packets: " << PACKET_SIZE << " rays, fixed at build time" << std::endl;
+	const int quota = util::CpuQuota();
+	std::cout << "Render threads: " << numThreads << " on " << util::AllowedCpus().size() << " CPUs"
+			  << (quota > 0 ? ", cgroup quota " + std::to_string(quota) : "") << (pinThreads ? ", pinned" : "") << std::endl;
+
 	srand(time(NULL));
 	util::Platform platform;
 	// Create the main window
 	sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Sunshine 0.1");
 
-	Raytracer tracer;
+	Raytracer tracer(numSpheres, accelType, numInstances, numThreads, pinThreads);
+	tracer.shadows = shadows;
+	tracer.packets = packets;
+	tracer.wavefront = wavefront;
+	tracer.sortRays = sortRays;
+	tracer.accumulate = accumulate;
+	tracer.accumulator.SetPrecision(precision);
+	tracer.accumulator.window = historyFrames;
 
 	// Create a graphical text to display
 	sf::Font font;
@@ -386,9 +699,20 @@ int main()
 	uint frame = 0;
 	std::string fpsString = "";
 	sf::Text fpsText;
+	sf::Text bounceText;
+
+	sf::Text stageText;
+	FrameStats stageSum;
 
 	tracer.UpdateRayDirections();
 
+	// Frames are simulated, traced and tonemapped by the frame graph, run from the pipeline's
+	// thread on the render threads, this one only shows them. Everything the tracer changes
+	// stays on those threads, the frames carry their stats.
+	FramePipeline<PipelinedFrame> pipeline(queueDepth, [&tracer](PipelinedFrame& next, const uint64_t index) {
+		tracer.ProduceFrame(next, index);
+	});
+
 	// Start the game loop
 	while (window.isOpen())
 	{
@@ -401,11 +725,16 @@ int main()
 				window.close();
 		}
 
-		tracer.Update();
+		PipelinedFrame& shown = pipeline.Acquire();
+		FrameStats& stats = shown.stats;
+		stats.waitMs = pipeline.WaitMs();
+		stats.stallMs = pipeline.StallMs();
 
 		// To the screen
+		auto start = std::chrono::steady_clock::now();
 		window.clear();
-		tracer.RenderMultiThread(window, 8);
+		tracer.drawFrame(window, shown.pixels.data());
+		stats.uploadMs = Raytracer::msSince(start);
 
 		// FPS
 		if (frame % 10 == 0)
@@ -413,16 +742,39 @@ int main()
 			const float tick = clock.getElapsedTime().asSeconds();
 			const int fps = round(1.0f / ((tick - lastTick) / 10.0f));
 			lastTick = tick;
-			fpsString = std::to_string(fps) + " fps";
+			fpsString = std::to_string(fps) + " fps (" + stats.scene + ", build " + std::to_string((int)round(stats.buildMs)) + " ms)";
+			if (accumulate)
+				fpsString += ", " + std::string(accumulation::PrecisionName(precision)) + " history " + std::to_string(stats.historyBytes >> 20) + " MB";
 			fpsText = sf::Text(fpsString, font, 20);
-		}
-		if (frame % 200 == 0)
-		{
-			tracer.ToggleSphereDirections();
+
+			// Milliseconds per stage over the last frames, the trace side and the showing side
+			const auto ms = [&stageSum, frame](const float sum) { return std::to_string((int)round(sum / std::max(1u, std::min(frame, 10u)))); };
+			const std::string stageString = "update " + ms(stageSum.updateMs) + ", trace " + ms(stageSum.traceMs) + ", resolve " + ms(stageSum.resolveMs) + ", stall " + ms(stageSum.stallMs)
+				+ " | wait " + ms(stageSum.waitMs) + ", upload " + ms(stageSum.uploadMs) + ", present " + ms(stageSum.presentMs) + " ms (queue " + std::to_string(pipeline.Depth()) + ")";
+			stageText = sf::Text(stageString, font, 16);
+			stageText.setPosition(0, 24);
+			stageSum = {};
+
+			// Rays and milliseconds per bounce, so it shows where the frame goes
+			std::string bounceString = "";
+			for (int b = 0; wavefront && b < Wavefront::MAX_BOUNCES && stats.bounces[b].rays > 0; b++)
+			{
+				const BounceStats& bounce = stats.bounces[b];
+				const float bounceMs = bounce.sortMs + bounce.intersectMs + bounce.shadowMs + bounce.shadeMs;
+				bounceString += "b" + std::to_string(b) + ": " + std::to_string(bounce.rays / 1000) + "k rays, " + std::to_string((int)round(bounceMs)) + " ms\n";
+			}
+			bounceText = sf::Text(bounceString, font, 16);
+			bounceText.setPosition(0, 44);
 		}
 
+		start = std::chrono::steady_clock::now();
 		window.draw(fpsText);
+		window.draw(stageText);
+		window.draw(bounceText);
 		window.display();
+		stats.presentMs = Raytracer::msSince(start);
+		stageSum += stats;
+		pipeline.Release();
 
 		frame += 1;
 	}
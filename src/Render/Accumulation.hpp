@@ -0,0 +1,209 @@
+#ifndef RENDER_ACCUMULATION_HPP
+#define RENDER_ACCUMULATION_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+#elif defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+
+#include "Scene.hpp"
+#include "Utility/Cpu.hpp"
+#include "Utility/Half.hpp"
+
+// Progressive rendering: the radiance of every frame is blended into a history that holds the
+// mean so far, and the mean is what gets tonemapped. The history can be kept in half precision,
+// which halves its memory and what every frame reads and writes of it.
+namespace accumulation
+{
+enum class Precision
+{
+	Float,
+	Half
+};
+
+inline const char* PrecisionName(const Precision precision)
+{
+	return precision == Precision::Half ? "fp16" : "fp32";
+}
+
+// history + (frame - history) * weight for count floats, rounded to half. history keeps the
+// new mean and frame gets it back exactly as stored.
+struct Blend
+{
+	util::Isa isa;
+	void (*blendHalf)(float*, uint16_t*, int, float);
+};
+
+namespace scalar
+{
+inline void BlendHalf(float* frame, uint16_t* history, const int count, const float weight)
+{
+	for (int i = 0; i < count; i++)
+	{
+		const float previous = util::HalfToFloat(history[i]);
+		history[i] = util::FloatToHalf(previous + (frame[i] - previous) * weight);
+		frame[i] = util::HalfToFloat(history[i]);
+	}
+}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+	#pragma GCC push_options
+	#pragma GCC target("avx2,f16c")
+namespace avx2
+{
+inline void BlendHalf(float* frame, uint16_t* history, const int count, const float weight)
+{
+	const __m256 w = _mm256_set1_ps(weight);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256 previous = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(history + i)));
+		const __m256 mean = _mm256_add_ps(previous, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(frame + i), previous), w));
+		const __m128i half = _mm256_cvtps_ph(mean, _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(history + i), half);
+		_mm256_storeu_ps(frame + i, _mm256_cvtph_ps(half));
+	}
+	scalar::BlendHalf(frame + i, history + i, count - i, weight);
+}
+}
+	#pragma GCC pop_options
+#elif defined(__aarch64__)
+namespace neon
+{
+inline void BlendHalf(float* frame, uint16_t* history, const int count, const float weight)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const float32x4_t previous = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(history + i)));
+		const float32x4_t mean = vaddq_f32(previous, vmulq_n_f32(vsubq_f32(vld1q_f32(frame + i), previous), weight));
+		const float16x4_t half = vcvt_f16_f32(mean);
+		vst1_u16(history + i, vreinterpret_u16_f16(half));
+		vst1q_f32(frame + i, vcvt_f32_f16(half));
+	}
+	scalar::BlendHalf(frame + i, history + i, count - i, weight);
+}
+}
+#endif
+
+// Every variant this build has, best first
+inline const std::vector<Blend>& Blends()
+{
+	static const std::vector<Blend> blends {
+#if defined(__x86_64__) || defined(__i386__)
+		{ util::Isa::AVX2, avx2::BlendHalf },
+#elif defined(__aarch64__)
+		{ util::Isa::NEON, neon::BlendHalf },
+#endif
+		{ util::Isa::Scalar, scalar::BlendHalf }
+	};
+	return blends;
+}
+
+inline const Blend& BestBlend()
+{
+	static const Blend& best = *std::find_if(Blends().begin(), Blends().end(), [](const Blend& blend) { return util::Supports(blend.isa); });
+	return best;
+}
+
+// Points in [0, 1) that fill the square evenly, subpixel offsets for frame index in base 2 and 3
+inline float Halton(int index, const int base)
+{
+	float result = 0;
+	float f = 1;
+	for (index += 1; index > 0; index /= base)
+	{
+		f /= base;
+		result += f * (index % base);
+	}
+	return result;
+}
+}
+
+// Mean of the frames added since the last Reset
+class Accumulator
+{
+public:
+	explicit Accumulator(const accumulation::Precision precision = accumulation::Precision::Float, const accumulation::Blend& blend = accumulation::BestBlend()) :
+		precision(precision),
+		blend(&blend)
+	{}
+
+	// 0 averages every frame, otherwise older frames fade out as if only the last window counted
+	int window = 0;
+
+	accumulation::Precision Precision() const
+	{
+		return precision;
+	}
+
+	void SetPrecision(const accumulation::Precision p)
+	{
+		precision = p;
+		floatHistory = {};
+		halfHistory = {};
+		Reset();
+	}
+
+	void Reset()
+	{
+		frames = 0;
+	}
+
+	int Frames() const
+	{
+		return frames;
+	}
+
+	// Memory of the history
+	size_t Bytes() const
+	{
+		return floatHistory.size() * sizeof(float) + halfHistory.size() * sizeof(uint16_t);
+	}
+
+	// Blends count colors in, frame gets the mean so far
+	void Add(Color* frame, const int count)
+	{
+		const int n = count * 3;
+		const size_t size = precision == accumulation::Precision::Half ? halfHistory.size() : floatHistory.size();
+		if (size != (size_t)n)
+			frames = 0;
+		// The first frame is taken as it is: 0 + (frame - 0) * 1
+		if (frames == 0)
+		{
+			if (precision == accumulation::Precision::Half)
+				halfHistory.assign(n, 0);
+			else
+				floatHistory.assign(n, 0.0f);
+		}
+
+		frames++;
+		const float weight = 1.0f / (window > 0 ? std::min(frames, window) : frames);
+		float* floats = &frame[0].r;
+		if (precision == accumulation::Precision::Half)
+		{
+			blend->blendHalf(floats, halfHistory.data(), n, weight);
+			return;
+		}
+		for (int i = 0; i < n; i++)
+		{
+			floatHistory[i] += (floats[i] - floatHistory[i]) * weight;
+			floats[i] = floatHistory[i];
+		}
+	}
+
+private:
+	accumulation::Precision precision;
+	const accumulation::Blend* blend;
+	int frames = 0;
+	std::vector<float> floatHistory;
+	std::vector<uint16_t> halfHistory;
+};
+
+#endif // RENDER_ACCUMULATION_HPP
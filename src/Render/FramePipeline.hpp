@@ -0,0 +1,122 @@
+#ifndef RENDER_FRAME_PIPELINE_HPP
+#define RENDER_FRAME_PIPELINE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Frames made on a producer thread and shown in order on the thread that owns the window,
+// through a ring of depth slots. The producer works on the next frames while the current one
+// is uploaded and presented, but never gets more than depth - 1 frames ahead of it, which is
+// what bounds the latency. Depth 1 makes and shows one frame after the other.
+template <typename Frame>
+class FramePipeline
+{
+public:
+	// produce(frame, index) fills the frames in order, index counting from 0
+	FramePipeline(const int depth, std::function<void(Frame&, uint64_t)> produce) :
+		slots(std::max(1, depth)),
+		produce(std::move(produce)),
+		producer([this]() { Produce(); })
+	{}
+
+	~FramePipeline()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		changed.notify_all();
+		producer.join();
+	}
+
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	int Depth() const
+	{
+		return (int)slots.size();
+	}
+
+	// Waits for the next frame, which is the caller's until Release
+	Frame& Acquire()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		Slot& slot = slots[consumed % slots.size()];
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&slot]() { return slot.ready; });
+		waitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return slot.frame;
+	}
+
+	// Hands the acquired frame's slot back to the producer
+	void Release()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slots[consumed % slots.size()].ready = false;
+			consumed++;
+		}
+		changed.notify_all();
+	}
+
+	// How long the last Acquire waited for the producer
+	float WaitMs() const
+	{
+		return waitMs;
+	}
+
+	// How long the producer waited for a free slot before making the acquired frame
+	float StallMs() const
+	{
+		return slots[consumed % slots.size()].stallMs;
+	}
+
+private:
+	struct Slot
+	{
+		Frame frame {};
+		bool ready = false;
+		float stallMs = 0;
+	};
+
+	void Produce()
+	{
+		for (uint64_t index = 0;; index++)
+		{
+			Slot& slot = slots[index % slots.size()];
+			const auto start = std::chrono::steady_clock::now();
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [this, &slot]() { return stopping || !slot.ready; });
+				if (stopping)
+					return;
+			}
+			// The slot isn't ready, so the consumer keeps away from it until it is
+			slot.stallMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			produce(slot.frame, index);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slot.ready = true;
+			}
+			changed.notify_all();
+		}
+	}
+
+	std::vector<Slot> slots;
+	std::function<void(Frame&, uint64_t)> produce;
+	std::mutex mutex;
+	std::condition_variable changed;
+	uint64_t consumed = 0;
+	float waitMs = 0;
+	bool stopping = false;
+	// Last, so it starts once everything it uses is there
+	std::thread producer;
+};
+
+#endif // RENDER_FRAME_PIPELINE_HPP
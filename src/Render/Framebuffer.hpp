@@ -0,0 +1,225 @@
+#ifndef RENDER_FRAMEBUFFER_HPP
+#define RENDER_FRAMEBUFFER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Scene.hpp"
+#include "Utility/Cpu.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+#elif defined(UTIL_NEON_VARIANTS)
+	#pragma GCC push_options
+	#if defined(__arm__)
+		#pragma GCC target("fpu=neon")
+	#endif
+	#include <arm_neon.h>
+	#pragma GCC pop_options
+#endif
+
+// The frame is traced into a float buffer of radiance and brought to the RGBA bytes the
+// texture is updated from in one pass at the end. The pass is built for several instruction
+// sets and picked at startup like the sphere kernels.
+namespace framebuffer
+{
+// Extended Reinhard curve on radiance scaled by exposure, then gamma 2 (a square root).
+// Unlike a clamp it keeps highlights apart instead of cutting them off at 255.
+struct Tonemap
+{
+	float exposure = 1.0f;
+	// Radiance that comes out white, in units of 255
+	float white = 4.0f;
+};
+
+// What every variant computes per channel, in this order so they all round alike
+struct Curve
+{
+	float scale; // exposure / 255
+	float invWhite2;
+
+	explicit Curve(const Tonemap& tonemap) :
+		scale(tonemap.exposure / 255.0f),
+		invWhite2(1.0f / (tonemap.white * tonemap.white))
+	{}
+};
+
+struct Conversion
+{
+	util::Isa isa;
+	// count colors to count RGBA pixels with alpha 255
+	void (*toRGBA)(const Color*, int, const Curve&, uint8_t*);
+};
+
+namespace scalar
+{
+inline uint8_t Channel(const float c, const Curve& curve)
+{
+	const float v = c * curve.scale;
+	const float mapped = std::min(std::max(v * (1.0f + v * curve.invWhite2) / (1.0f + v), 0.0f), 1.0f);
+	return (uint8_t)std::nearbyint(std::sqrt(mapped) * 255.0f);
+}
+
+inline void ToRGBA(const Color* colors, const int count, const Curve& curve, uint8_t* out)
+{
+	for (int i = 0; i < count; i++)
+	{
+		out[i * 4 + 0] = Channel(colors[i].r, curve);
+		out[i * 4 + 1] = Channel(colors[i].g, curve);
+		out[i * 4 + 2] = Channel(colors[i].b, curve);
+		out[i * 4 + 3] = 255;
+	}
+}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+	#pragma GCC push_options
+	#pragma GCC target("ssse3,sse4.1")
+namespace sse4
+{
+// The curve is the same for every channel, so the twelve floats of four colors are mapped as
+// they lie in memory. Their bytes are then spread out to make room for alpha.
+inline __m128i Channels(const __m128 c, const __m128 scale, const __m128 invWhite2)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 v = _mm_mul_ps(c, scale);
+	const __m128 curve = _mm_div_ps(_mm_mul_ps(v, _mm_add_ps(one, _mm_mul_ps(v, invWhite2))), _mm_add_ps(one, v));
+	const __m128 mapped = _mm_min_ps(_mm_max_ps(curve, _mm_setzero_ps()), one);
+	return _mm_cvtps_epi32(_mm_mul_ps(_mm_sqrt_ps(mapped), _mm_set1_ps(255.0f)));
+}
+
+inline void ToRGBA(const Color* colors, const int count, const Curve& curve, uint8_t* out)
+{
+	const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	const __m128 scale = _mm_set1_ps(curve.scale);
+	const __m128 invWhite2 = _mm_set1_ps(curve.invWhite2);
+	const float* floats = &colors[0].r;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i a = Channels(_mm_loadu_ps(floats + i * 3), scale, invWhite2);
+		const __m128i b = Channels(_mm_loadu_ps(floats + i * 3 + 4), scale, invWhite2);
+		const __m128i c = Channels(_mm_loadu_ps(floats + i * 3 + 8), scale, invWhite2);
+		const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, c));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_or_si128(_mm_shuffle_epi8(bytes, spread), alpha));
+	}
+	scalar::ToRGBA(colors + i, count - i, curve, out + i * 4);
+}
+}
+	#pragma GCC pop_options
+
+	#pragma GCC push_options
+	#pragma GCC target("avx2")
+namespace avx2
+{
+inline __m256i Channels(const __m256 c, const __m256 scale, const __m256 invWhite2)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 v = _mm256_mul_ps(c, scale);
+	const __m256 curve = _mm256_div_ps(_mm256_mul_ps(v, _mm256_add_ps(one, _mm256_mul_ps(v, invWhite2))), _mm256_add_ps(one, v));
+	const __m256 mapped = _mm256_min_ps(_mm256_max_ps(curve, _mm256_setzero_ps()), one);
+	return _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_sqrt_ps(mapped), _mm256_set1_ps(255.0f)));
+}
+
+// Eight colors per step. The packs work within 128 bit halves, a dword permute puts the
+// twelve bytes of pixels 0 - 3 and 4 - 7 back in order in their halves before spreading them.
+inline void ToRGBA(const Color* colors, const int count, const Curve& curve, uint8_t* out)
+{
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 0, 5, 2, 6, 0);
+	const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+	const __m256 scale = _mm256_set1_ps(curve.scale);
+	const __m256 invWhite2 = _mm256_set1_ps(curve.invWhite2);
+	const float* floats = &colors[0].r;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i a = Channels(_mm256_loadu_ps(floats + i * 3), scale, invWhite2);
+		const __m256i b = Channels(_mm256_loadu_ps(floats + i * 3 + 8), scale, invWhite2);
+		const __m256i c = Channels(_mm256_loadu_ps(floats + i * 3 + 16), scale, invWhite2);
+		const __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, c));
+		const __m256i rgb = _mm256_permutevar8x32_epi32(bytes, order);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(rgb, spread), alpha));
+	}
+	scalar::ToRGBA(colors + i, count - i, curve, out + i * 4);
+}
+}
+	#pragma GCC pop_options
+#elif defined(UTIL_NEON_VARIANTS)
+	#pragma GCC push_options
+	#if defined(__arm__)
+		#pragma GCC target("fpu=neon")
+	#endif
+namespace neon
+{
+inline uint16x4_t Channels(const float32x4_t c, const Curve& curve)
+{
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t v = vmulq_n_f32(c, curve.scale);
+	float32x4_t mapped = vmulq_f32(v, vaddq_f32(one, vmulq_n_f32(v, curve.invWhite2)));
+	float lanes[4], below[4];
+	vst1q_f32(lanes, mapped);
+	vst1q_f32(below, vaddq_f32(one, v));
+	// Divide and square root lane by lane, NEON's estimates would round differently
+	for (int i = 0; i < 4; i++)
+	{
+		lanes[i] = std::nearbyint(std::sqrt(std::min(std::max(lanes[i] / below[i], 0.0f), 1.0f)) * 255.0f);
+	}
+	return vqmovun_s32(vcvtq_s32_f32(vld1q_f32(lanes)));
+}
+
+// Eight colors per step, de-interleaved on load and interleaved again with alpha on store
+inline void ToRGBA(const Color* colors, const int count, const Curve& curve, uint8_t* out)
+{
+	const float* floats = &colors[0].r;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const float32x4x3_t lo = vld3q_f32(floats + i * 3);
+		const float32x4x3_t hi = vld3q_f32(floats + i * 3 + 12);
+		uint8x8x4_t rgba;
+		for (int channel = 0; channel < 3; channel++)
+		{
+			rgba.val[channel] = vqmovn_u16(vcombine_u16(Channels(lo.val[channel], curve), Channels(hi.val[channel], curve)));
+		}
+		rgba.val[3] = vdup_n_u8(255);
+		vst4_u8(out + i * 4, rgba);
+	}
+	scalar::ToRGBA(colors + i, count - i, curve, out + i * 4);
+}
+}
+	#pragma GCC pop_options
+#endif
+
+// Every variant this build has, best first
+inline const std::vector<Conversion>& Conversions()
+{
+	static const std::vector<Conversion> conversions {
+#if defined(__x86_64__) || defined(__i386__)
+		{ util::Isa::AVX2, avx2::ToRGBA },
+		{ util::Isa::SSE4, sse4::ToRGBA },
+#elif defined(UTIL_NEON_VARIANTS)
+		{ util::Isa::NEON, neon::ToRGBA },
+#endif
+		{ util::Isa::Scalar, scalar::ToRGBA }
+	};
+	return conversions;
+}
+
+inline const Conversion& BestConversion()
+{
+	static const Conversion& best = *std::find_if(Conversions().begin(), Conversions().end(), [](const Conversion& conversion) { return util::Supports(conversion.isa); });
+	return best;
+}
+
+inline void ToRGBA(const Color* colors, const int count, const Tonemap& tonemap, uint8_t* out)
+{
+	BestConversion().toRGBA(colors, count, Curve(tonemap), out);
+}
+}
+
+#endif // RENDER_FRAMEBUFFER_HPP
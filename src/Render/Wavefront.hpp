@@ -0,0 +1,278 @@
+#ifndef RENDER_WAVEFRONT_HPP
+#define RENDER_WAVEFRONT_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Accel/IAccelerator.hpp"
+#include "Accel/Morton.hpp"
+#include "Constants.h"
+#include "Scene.hpp"
+
+// What one bounce of a frame cost, summed over all tiles
+struct BounceStats
+{
+	int rays = 0;
+	int hits = 0;
+	int shadowRays = 0;
+	float sortMs = 0.0f;
+	float intersectMs = 0.0f;
+	float shadowMs = 0.0f;
+	float shadeMs = 0.0f;
+
+	void operator+=(const BounceStats& other)
+	{
+		rays += other.rays;
+		hits += other.hits;
+		shadowRays += other.shadowRays;
+		sortMs += other.sortMs;
+		intersectMs += other.intersectMs;
+		shadowMs += other.shadowMs;
+		shadeMs += other.shadeMs;
+	}
+};
+
+// Breadth-first alternative to the recursive castRay: all rays of one bounce are intersected
+// as a stream, the ones that hit are compacted into a hit queue, shaded together with their
+// shadow rays, and spawn the next bounce's queue. Reflections are added back to front once
+// the last bounce is done, which gives exactly the colors of the recursion.
+class Wavefront
+{
+public:
+	static constexpr int MAX_BOUNCES = MAX_REFLECTION_DEPTH + 1;
+
+	// Summed over every Render since they were last cleared
+	std::array<BounceStats, MAX_BOUNCES> stats {};
+
+	// Traces count camera rays from orig, out gets their radiance
+	void Render(const IRayQuery& scene, const std::vector<Light>& lights, const Vec3f& orig, const Vec3f* directions, const int count, Color* out)
+	{
+		local.resize((size_t)MAX_BOUNCES * count);
+		pathLength.assign(count, 0);
+
+		rays.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			rays[i] = { orig, directions[i], i };
+		}
+
+		for (int bounce = 0; bounce < MAX_BOUNCES && !rays.empty(); bounce++)
+		{
+			BounceStats& bounceStats = stats[bounce];
+			bounceStats.rays += (int)rays.size();
+
+			auto start = std::chrono::steady_clock::now();
+			if (bounce > 0 && sortRays && packets && scene.TracesPackets())
+			{
+				Sort();
+				bounceStats.sortMs += MsSince(start);
+				start = std::chrono::steady_clock::now();
+			}
+			Intersect(scene);
+			bounceStats.intersectMs += MsSince(start);
+
+			start = std::chrono::steady_clock::now();
+			Occlude(scene, lights);
+			bounceStats.hits += (int)hitQueue.size();
+			bounceStats.shadowRays += (int)shadowRays.size();
+			bounceStats.shadowMs += MsSince(start);
+
+			start = std::chrono::steady_clock::now();
+			Shade(lights, bounce, count);
+			bounceStats.shadeMs += MsSince(start);
+		}
+
+		// Every path adds its reflections from the last hit back to the first
+		for (int path = 0; path < count; path++)
+		{
+			Color& color = out[path];
+			color = Color {};
+			for (int bounce = pathLength[path] - 1; bounce >= 0; bounce--)
+			{
+				Color reflection = color;
+				color = local[(size_t)bounce * count + path];
+				if (bounce < MAX_REFLECTION_DEPTH)
+				{
+					reflection *= std::pow(0.6, bounce + 1);
+					color += reflection;
+				}
+			}
+		}
+	}
+
+	// Lights blocked by other spheres don't contribute
+	bool shadows = true;
+	// Streams are handed to the scene's packet queries in runs of PACKET_SIZE
+	bool packets = true;
+	// Reflection rays are reordered by direction octant and origin before they are traced in
+	// packets. Single rays don't gain enough from the order to pay for the sort.
+	bool sortRays = true;
+
+private:
+	struct Ray
+	{
+		Vec3f orig;
+		Vec3f dir;
+		int path;
+	};
+
+	struct Hit
+	{
+		Collision collision;
+		int path;
+		uint32_t blocked;
+	};
+
+	// Reflections leave in every direction from all over the scene. Sorting them by direction
+	// octant first and by the Morton code of their origin second puts rays that share a sign
+	// pattern and start close to each other next to each other, so consecutive rays (and the
+	// packets built from them) walk the same nodes while they are still in cache.
+	void Sort()
+	{
+		AABB bounds;
+		for (const auto& ray : rays)
+		{
+			bounds.Grow(ray.orig);
+		}
+		const Vec3f extent = bounds.Extent();
+		const Vec3f scale(extent.x > 0 ? 1.0f / extent.x : 0.0f, extent.y > 0 ? 1.0f / extent.y : 0.0f, extent.z > 0 ? 1.0f / extent.z : 0.0f);
+
+		const int n = (int)rays.size();
+		sortKeys.resize(n);
+		for (int i = 0; i < n; i++)
+		{
+			const Vec3f& dir = rays[i].dir;
+			const uint64_t octant = (dir.x < 0 ? 4 : 0) | (dir.y < 0 ? 2 : 0) | (dir.z < 0 ? 1 : 0);
+			const Vec3f p = rays[i].orig - bounds.min;
+			// 7 bits per axis are plenty to group rays, and keep the sort at three passes
+			const uint64_t morton = MortonCode(Vec3f(p.x * scale.x, p.y * scale.y, p.z * scale.z), 30) >> 9;
+			sortKeys[i] = (octant << 21) | morton;
+		}
+		// Every render thread has its own wavefront, so the sort stays on this one
+		RadixSort(sortKeys, rays, 24);
+	}
+
+	// Closest hits of the ray queue, the rays that hit something are compacted into hitQueue
+	void Intersect(const IRayQuery& scene)
+	{
+		const int n = (int)rays.size();
+		hits.resize(n);
+		if (packets && scene.TracesPackets())
+		{
+			for (int first = 0; first < n; first += PACKET_SIZE)
+			{
+				Packet packet;
+				for (int i = 0; i < PACKET_SIZE && first + i < n; i++)
+				{
+					packet.Set(i, rays[first + i].orig, rays[first + i].dir, MAX_RAY_DISTANCE);
+				}
+				RayHit packetHits[PACKET_SIZE];
+				scene.ClosestPacket(packet, packetHits);
+				std::copy(packetHits, packetHits + std::min(PACKET_SIZE, n - first), hits.begin() + first);
+			}
+		}
+		else
+		{
+			for (int i = 0; i < n; i++)
+			{
+				hits[i] = scene.Closest(rays[i].orig, rays[i].dir);
+			}
+		}
+
+		hitQueue.clear();
+		for (int i = 0; i < n; i++)
+		{
+			if (hits[i].distance > 0 && hits[i].distance < MAX_RAY_DISTANCE)
+				hitQueue.push_back({ scene.Shade(rays[i].orig, rays[i].dir, hits[i]), rays[i].path, 0 });
+		}
+	}
+
+	// One shadow ray per hit and light, light by light so neighbouring rays stay coherent
+	void Occlude(const IRayQuery& scene, const std::vector<Light>& lights)
+	{
+		shadowRays.clear();
+		if (!shadows)
+			return;
+
+		for (int light = 0; light < (int)lights.size(); light++)
+		{
+			for (const auto& hit : hitQueue)
+			{
+				Vec3f path {};
+				const float lightDistance = LightPath(hit.collision, lights[light], path);
+				shadowRays.push_back({ hit.collision.position + hit.collision.normal * SHADOW_BIAS, path * -1.0f, lightDistance });
+			}
+		}
+
+		const int n = (int)shadowRays.size();
+		const int numHits = (int)hitQueue.size();
+		if (packets && scene.TracesPackets())
+		{
+			for (int first = 0; first < n; first += PACKET_SIZE)
+			{
+				Packet packet;
+				for (int i = 0; i < PACKET_SIZE && first + i < n; i++)
+				{
+					packet.Set(i, shadowRays[first + i].orig, shadowRays[first + i].dir, shadowRays[first + i].distance);
+				}
+				uint32_t occluded = scene.OccludedPacket(packet);
+				while (occluded)
+				{
+					const int i = first + __builtin_ctz(occluded);
+					occluded &= occluded - 1;
+					hitQueue[i % numHits].blocked |= 1u << (i / numHits);
+				}
+			}
+		}
+		else
+		{
+			for (int i = 0; i < n; i++)
+			{
+				if (scene.Occluded(shadowRays[i].orig, shadowRays[i].dir, shadowRays[i].distance))
+					hitQueue[i % numHits].blocked |= 1u << (i / numHits);
+			}
+		}
+	}
+
+	// Direct light of every hit, reflections become the next bounce's rays
+	void Shade(const std::vector<Light>& lights, const int bounce, const int count)
+	{
+		nextRays.clear();
+		for (const auto& hit : hitQueue)
+		{
+			local[(size_t)bounce * count + hit.path] = DirectLight(hit.collision, lights, hit.blocked);
+			pathLength[hit.path] = bounce + 1;
+			if (bounce < MAX_REFLECTION_DEPTH)
+				nextRays.push_back({ hit.collision.position, hit.collision.reflection, hit.path });
+		}
+		std::swap(rays, nextRays);
+	}
+
+	static float MsSince(const std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	struct ShadowRay
+	{
+		Vec3f orig;
+		Vec3f dir;
+		float distance;
+	};
+
+	// Queues are kept between frames so they don't get reallocated
+	std::vector<Ray> rays;
+	std::vector<Ray> nextRays;
+	std::vector<uint64_t> sortKeys;
+	std::vector<RayHit> hits;
+	std::vector<Hit> hitQueue;
+	std::vector<ShadowRay> shadowRays;
+	std::vector<Color> local; // Direct light per bounce and path
+	std::vector<int> pathLength; // Bounces that hit something
+};
+
+#endif // RENDER_WAVEFRONT_HPP
@@ -0,0 +1,245 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "Accel/AABB.hpp"
+#include "Constants.h"
+#include "Geometry.cpp"
+
+// Setup scene
+// Radiance in display units: 255 is white, brighter light goes beyond it and is only brought
+// back into range by the tonemap at the end of the frame
+struct Color
+{
+	float r, g, b;
+	Color() :
+		r(0),
+		g(0),
+		b(0)
+	{}
+	Color(float re, float gr, float bl) :
+		r(re),
+		g(gr),
+		b(bl)
+	{}
+	void operator+=(const Color& col)
+	{
+		r += col.r;
+		g += col.g;
+		b += col.b;
+	}
+	Color operator*(const float f) const
+	{
+		return Color(r * f, g * f, b * f);
+	}
+	void operator*=(const float f)
+	{
+		r *= f;
+		g *= f;
+		b *= f;
+	}
+};
+
+struct Light
+{
+	Vec3f position {};
+	float brightness;
+
+	Light(const Vec3f pos, const float bright) :
+		position(pos),
+		brightness(bright)
+	{}
+};
+
+struct Collision
+{
+	Vec3f position;
+	Vec3f reflection;
+	Vec3f normal;
+	Color color;
+	float distance = 0;
+};
+
+// Result of the intersection phase: which primitive is hit and how far away. The Collision
+// is built afterwards for the closest one only.
+struct RayHit
+{
+	float distance = 0; // 0 means no hit
+	int prim = -1;
+	int instance = -1; // Set by two-level structures
+};
+
+struct Sphere
+{
+	Vec3f position {};
+	float radius {};
+	Color color {};
+	Vec3f velocity {};
+	bool forward = true;
+
+	Sphere(const Vec3f pos, const float rad, const Color col, const Vec3f vel) :
+		position(pos),
+		radius(rad),
+		color(col),
+		velocity(vel)
+	{}
+
+	// Distance along the ray to the nearest hit in front of the origin, 0 for a miss.
+	// The discriminant is r^2 minus the squared distance of the center from the ray, which
+	// keeps its precision for far away spheres unlike p^2 - (|o - c|^2 - r^2).
+	float HitDistance(
+		const Vec3f& orig,
+		const Vec3f& direction) const
+	{
+		const auto o_minus_c = orig - position;
+
+		const auto p = direction.dotProduct(o_minus_c);
+		const auto perpendicular = o_minus_c - direction * p;
+
+		const auto discriminant = (radius * radius) - perpendicular.dotProduct(perpendicular);
+		if (discriminant < 0.0f)
+		{
+			return 0;
+		}
+
+		const auto dRoot = std::sqrt(discriminant);
+		// auto dist = std::min(-p - dRoot, -p + dRoot);
+		const auto dist = -p - dRoot;
+		return dist < 0 ? 0 : dist;
+	}
+
+	// Hit record for a distance found by HitDistance, only built for the closest hit
+	Collision Shade(
+		const Vec3f& orig,
+		const Vec3f& direction,
+		const float dist) const
+	{
+		// Calc hit position and reflection
+		Collision hit {};
+		hit.position = orig + direction * dist;
+		hit.normal = hit.position - position;
+		hit.normal.normalize();
+		hit.reflection = direction - hit.normal * 2 * direction.dotProduct(hit.normal);
+		hit.color = color;
+		hit.distance = dist;
+
+		return hit;
+	}
+
+	Collision RayIntersection(
+		const Vec3f& orig,
+		const Vec3f& direction) const
+	{
+		const float dist = HitDistance(orig, direction);
+		return dist > 0 ? Shade(orig, direction, dist) : Collision {};
+	}
+
+	bool Occludes(const Vec3f& orig, const Vec3f& direction, const float maxDistance) const
+	{
+		const float dist = HitDistance(orig, direction);
+		return dist > 0 && dist < maxDistance;
+	}
+
+	AABB Bounds() const
+	{
+		return AABB(position - Vec3f(radius), position + Vec3f(radius));
+	}
+
+	void Update(const float dT)
+	{
+		if (forward)
+			position += velocity * dT;
+		else
+			position -= velocity * dT;
+	}
+
+	void ToggleDirection()
+	{
+		forward = !forward;
+	}
+};
+
+// Unit vector from the light to the hit, returns the distance between them
+inline float LightPath(const Collision& hit, const Light& light, Vec3f& path)
+{
+	path = hit.position - light.position;
+	const float lightDistance = path.length();
+	path /= lightDistance;
+	return lightDistance;
+}
+
+// Diffuse color of a hit lit by every light whose bit is not set in blocked. Scalar on every
+// instruction set for now: most of it is the acos, and a vector acos would change the images.
+inline Color DirectLight(Collision hit, const std::vector<Light>& lights, const uint32_t blocked)
+{
+	Color out_color {};
+	for (int i = 0; i < (int)lights.size(); i++)
+	{
+		if ((blocked >> i) & 1)
+			continue;
+		Vec3f path {};
+		LightPath(hit, lights[i], path);
+		hit.color *= (acos(path.dotProduct(hit.normal)) / PI) * lights[i].brightness;
+		out_color += hit.color;
+	}
+	return out_color;
+}
+
+// Random spheres in front of the camera
+inline std::vector<Sphere> GenerateSpheres(const int numSpheres)
+{
+	std::vector<Sphere> spheres;
+	// Shrink spheres in crowded scenes so they don't all overlap
+	const float radiusScale = std::min(1.0f, std::cbrt(8.0f / numSpheres));
+	for (int i = 0; i < numSpheres; i++)
+	{
+		const auto pos = Vec3f(
+			-5.0 + (10.0 * ((rand() % 1000) / 1000.0)),
+			-3.0 + (6.0 * ((rand() % 1000) / 1000.0)),
+			-10.0 - 20.0 * ((rand() % 1000) / 1000));
+
+		auto vel = Vec3f((rand() % 1000), (rand() % 1000), (rand() % 1000));
+		vel /= 2000.0;
+
+		const auto col = Color(rand() % 255, rand() % 255, rand() % 255);
+		auto s1 = Sphere(pos, radiusScale * (0.5 + (rand() % 1000) / 1000.0), col, vel);
+		spheres.push_back(s1);
+	}
+	return spheres;
+}
+
+// Random spheres around the origin within [-1, 1]^3, meant to be instanced
+inline std::vector<Sphere> GenerateCluster(const int numSpheres)
+{
+	std::vector<Sphere> spheres;
+	const float radiusScale = std::min(1.0f, std::cbrt(8.0f / numSpheres));
+	for (int i = 0; i < numSpheres; i++)
+	{
+		const auto pos = Vec3f(
+			-1.0 + 2.0 * ((rand() % 1000) / 1000.0),
+			-1.0 + 2.0 * ((rand() % 1000) / 1000.0),
+			-1.0 + 2.0 * ((rand() % 1000) / 1000.0));
+
+		const auto col = Color(rand() % 255, rand() % 255, rand() % 255);
+		spheres.push_back(Sphere(pos, radiusScale * (0.1 + 0.2 * (rand() % 1000) / 1000.0), col, Vec3f(0)));
+	}
+	return spheres;
+}
+
+// Uniform scale, rotation about the y axis, then translation (row vectors as in Matrix44)
+inline Matrix44f InstanceTransform(const Vec3f& position, const float angle, const float scale = 1.0f)
+{
+	const float c = std::cos(angle) * scale;
+	const float s = std::sin(angle) * scale;
+	return Matrix44f(
+		c, 0, -s, 0,
+		0, scale, 0, 0,
+		s, 0, c, 0,
+		position.x, position.y, position.z, 1);
+}
+
+#endif // SCENE_HPP
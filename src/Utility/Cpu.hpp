@@ -0,0 +1,106 @@
+#ifndef UTIL_CPU_HPP
+#define UTIL_CPU_HPP
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__arm__) && defined(__linux__)
+	#include <asm/hwcap.h>
+	#include <sys/auxv.h>
+#endif
+
+// Builds that carry NEON variants: 64 bit ARM always has NEON. 32 bit ARM builds with a hardware
+// float ABI compile them under #pragma GCC target("fpu=neon"), whether or not the build targets
+// NEON, and the hwcaps tell if they can run.
+#if defined(__aarch64__) || (defined(__arm__) && !defined(__SOFTFP__))
+	#define UTIL_NEON_VARIANTS
+#endif
+
+namespace util
+{
+// Instruction set tiers the SIMD kernels are built for, each one includes the ones before it
+// on the same architecture
+enum class Isa
+{
+	Scalar,
+	SSE2,
+	SSE4, // SSSE3 and SSE4.1
+	AVX2, // and F16C
+	AVX512, // AVX-512F
+	NEON
+};
+
+inline const char* IsaName(const Isa isa)
+{
+	switch (isa)
+	{
+		case Isa::SSE2:
+			return "sse2";
+		case Isa::SSE4:
+			return "sse4";
+		case Isa::AVX2:
+			return "avx2";
+		case Isa::AVX512:
+			return "avx512";
+		case Isa::NEON:
+			return "neon";
+		default:
+			return "scalar";
+	}
+}
+
+// Best tier this CPU (and its OS, for the AVX register state) supports
+inline Isa DetectIsa()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return Isa::AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c"))
+		return Isa::AVX2;
+	if (__builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1"))
+		return Isa::SSE4;
+	if (__builtin_cpu_supports("sse2"))
+		return Isa::SSE2;
+	return Isa::Scalar;
+#elif defined(__aarch64__)
+	return Isa::NEON;
+#elif defined(__arm__) && defined(__linux__)
+	return (getauxval(AT_HWCAP) & HWCAP_NEON) ? Isa::NEON : Isa::Scalar;
+#else
+	return Isa::Scalar;
+#endif
+}
+
+// Whether a CPU of tier cpu runs kernels built for isa
+inline bool Includes(const Isa cpu, const Isa isa)
+{
+	if (isa == Isa::Scalar || isa == cpu)
+		return true;
+	return cpu != Isa::NEON && isa != Isa::NEON && isa <= cpu;
+}
+
+// Detected once. SUNSHINE_ISA=<scalar|sse2|sse4|avx2|avx512|neon> lowers it, to compare the
+// kernels or to work around a misbehaving machine.
+inline Isa CpuIsa()
+{
+	static const Isa isa = []() {
+		const Isa detected = DetectIsa();
+		const char* cap = std::getenv("SUNSHINE_ISA");
+		for (const Isa tier : { Isa::Scalar, Isa::SSE2, Isa::SSE4, Isa::AVX2, Isa::AVX512, Isa::NEON })
+		{
+			if (cap != nullptr && std::strcmp(cap, IsaName(tier)) == 0 && Includes(detected, tier))
+				return tier;
+		}
+		return detected;
+	}();
+	return isa;
+}
+
+inline bool Supports(const Isa isa)
+{
+	return Includes(CpuIsa(), isa);
+}
+}
+
+#endif // UTIL_CPU_HPP
@@ -0,0 +1,73 @@
+#ifndef UTIL_DOUBLE_BUFFER_HPP
+#define UTIL_DOUBLE_BUFFER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace util
+{
+// Two copies of T, RCU style: readers take the published copy without a lock and keep it as long
+// as they like, while one writer fills the other copy and publishes it by flipping an atomic
+// index. Before the writer touches a copy again it waits until every reader that took it has
+// let go (the grace period), so a published T is never changed under a reader.
+template <typename T>
+class DoubleBuffer
+{
+public:
+	// Reader side: the newest published copy, which stays valid until Release
+	const T* Acquire()
+	{
+		while (true)
+		{
+			const int i = published.load();
+			pins[i].fetch_add(1);
+			// The writer may have flipped and started on i between the two lines above, it
+			// only does that after seeing no pins, so check again now that i is pinned
+			if (published.load() == i)
+				return &items[i];
+			Unpin(i);
+		}
+	}
+
+	void Release(const T* item)
+	{
+		Unpin((int)(item - items));
+	}
+
+	// Writer side: the copy that isn't published, once no reader holds it any more. It has
+	// whatever the writer left in it two publishes ago.
+	T& Back()
+	{
+		const int i = 1 - published.load();
+		std::unique_lock<std::mutex> lock(mutex);
+		released.wait(lock, [this, i]() { return pins[i].load() == 0; });
+		return items[i];
+	}
+
+	// Makes the copy from Back the one readers get
+	void Publish()
+	{
+		published.store(1 - published.load());
+	}
+
+private:
+	void Unpin(const int i)
+	{
+		// Only the last reader out takes the lock, to wake a writer waiting for the copy
+		if (pins[i].fetch_sub(1) == 1)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			released.notify_all();
+		}
+	}
+
+	T items[2] {};
+	std::atomic<int> pins[2] { { 0 }, { 0 } };
+	std::atomic<int> published { 0 };
+	std::mutex mutex;
+	std::condition_variable released;
+};
+}
+
+#endif // UTIL_DOUBLE_BUFFER_HPP
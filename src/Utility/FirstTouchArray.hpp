@@ -0,0 +1,82 @@
+#ifndef UTIL_FIRST_TOUCH_ARRAY_HPP
+#define UTIL_FIRST_TOUCH_ARRAY_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace util
+{
+// Fixed number of Ts starting on a cache line, left unwritten until Touch constructs them. Linux
+// puts a page on the NUMA node of the thread that first writes it, so each thread touching the
+// part it is going to work on keeps that part in memory next to it.
+template <typename T>
+class FirstTouchArray
+{
+	static_assert(std::is_trivially_destructible<T>::value, "Elements are never destroyed");
+
+public:
+	explicit FirstTouchArray(const size_t count) :
+		items(static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(64)))),
+		count(count)
+	{}
+
+	~FirstTouchArray()
+	{
+		::operator delete(items, std::align_val_t(64));
+	}
+
+	FirstTouchArray(const FirstTouchArray&) = delete;
+	FirstTouchArray& operator=(const FirstTouchArray&) = delete;
+
+	// Default constructs items first .. first + n, from the thread that will use them
+	void Touch(const size_t first, const size_t n)
+	{
+		for (size_t i = first; i < first + n; i++)
+		{
+			::new (static_cast<void*>(items + i)) T();
+		}
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	T* data()
+	{
+		return items;
+	}
+
+	const T* data() const
+	{
+		return items;
+	}
+
+	T& operator[](const size_t i)
+	{
+		return items[i];
+	}
+
+	const T& operator[](const size_t i) const
+	{
+		return items[i];
+	}
+
+	T* begin()
+	{
+		return items;
+	}
+
+	T* end()
+	{
+		return items + count;
+	}
+
+private:
+	T* items;
+	size_t count;
+};
+}
+
+#endif // UTIL_FIRST_TOUCH_ARRAY_HPP
@@ -0,0 +1,55 @@
+#ifndef UTIL_HALF_HPP
+#define UTIL_HALF_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace util
+{
+// IEEE half precision conversions in software, rounding like F16C's _MM_FROUND_TO_NEAREST_INT
+// so the SIMD conversions can be checked against them bit for bit
+inline uint16_t FloatToHalf(const float f)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+	const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	const uint32_t magnitude = bits & 0x7fffffff;
+	// Infinity, or NaN with the top of its payload kept and made quiet
+	if (magnitude >= 0x7f800000)
+		return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 | ((magnitude >> 13) & 0x3ff) : 0);
+	// Rounds past 65504, the largest half
+	if (magnitude >= 0x477ff000)
+		return sign | 0x7c00;
+	// Below 2^-14 halves are denormal, steps of 2^-24. Scaling by a power of two is exact and
+	// nearbyint rounds to even.
+	if (magnitude < 0x38800000)
+		return sign | (uint16_t)std::nearbyint(std::fabs(f) * 16777216.0f);
+	// Round to even at the 13 mantissa bits that are dropped, a carry moves into the exponent
+	const uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+	return sign | (uint16_t)((rounded - 0x38000000) >> 13);
+}
+
+inline float HalfToFloat(const uint16_t h)
+{
+	const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	const uint32_t exponent = (h >> 10) & 0x1f;
+	const uint32_t mantissa = h & 0x3ff;
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		const float denormal = mantissa * (1.0f / 16777216.0f);
+		std::memcpy(&bits, &denormal, sizeof(bits));
+		bits |= sign;
+	}
+	else if (exponent == 0x1f)
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	else
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+}
+
+#endif // UTIL_HALF_HPP
@@ -0,0 +1,44 @@
+#ifndef UTIL_PARALLEL_HPP
+#define UTIL_PARALLEL_HPP
+
+#include <algorithm>
+
+namespace util
+{
+// Threads that are already running and take the chunks of parallel loops, such as a ThreadPool
+class Workers
+{
+public:
+	virtual ~Workers() = default;
+
+	// Threads that can work on a loop at once, the caller included
+	virtual int Size() const = 0;
+
+	// Calls run(context, chunk) once for every chunk in [0, chunks) and returns when all of them
+	// are done, the caller works along
+	virtual void RunChunks(int chunks, void (*run)(void*, int), void* context) = 0;
+};
+
+// Splits [0, count) into up to numThreads contiguous chunks and calls f(chunk, begin, end) for
+// each on workers, or one after the other on the calling thread without workers
+template <typename F>
+void ParallelFor(Workers* workers, const int numThreads, const int count, F&& f)
+{
+	const int chunks = std::max(1, std::min(numThreads, count));
+	const auto chunk = [&f, chunks, count](const int t) {
+		f(t, (int)((long long)count * t / chunks), (int)((long long)count * (t + 1) / chunks));
+	};
+	if (!workers || chunks == 1)
+	{
+		for (int t = 0; t < chunks; t++)
+		{
+			chunk(t);
+		}
+		return;
+	}
+	workers->RunChunks(
+		chunks, [](void* context, const int t) { (*static_cast<const decltype(chunk)*>(context))(t); }, const_cast<void*>(static_cast<const void*>(&chunk)));
+}
+}
+
+#endif // UTIL_PARALLEL_HPP
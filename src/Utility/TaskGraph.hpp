@@ -0,0 +1,249 @@
+#ifndef UTIL_TASK_GRAPH_HPP
+#define UTIL_TASK_GRAPH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+
+#include "Utility/ThreadPool.hpp"
+
+namespace util
+{
+// Tasks that start once the tasks they depend on are done, run by every thread of a ThreadPool.
+// A task comes in parts that free threads take one at a time, so independent tasks overlap and
+// a thread busy with a long task leaves the parts of the others to the rest. Tasks can run
+// parallel loops on the graph as well, their chunks go to the threads that are free first. The
+// graph is built once and run every frame, running it allocates nothing.
+class TaskGraph : public Workers
+{
+public:
+	using Task = int;
+
+	explicit TaskGraph(ThreadPool& threadPool) :
+		pool(threadPool)
+	{
+		loops.reserve(pool.Size());
+	}
+
+	// f(part, thread) is called once for every part in [0, parts) after the tasks in after are
+	// done. Of the tasks that are ready, the one added first gets the next free thread, so add
+	// the tasks a long one shouldn't hold up before it. f mustn't Run the pool the graph runs on,
+	// but can run loops on the graph.
+	Task Add(const char* name, const int parts, std::function<void(int, int)> f, std::initializer_list<Task> after = {})
+	{
+		const Task task = (Task)nodes.size();
+		nodes.emplace_back();
+		Node& node = nodes.back();
+		node.name = name;
+		node.parts = std::max(1, parts);
+		node.f = std::move(f);
+		node.dependencies = (int)after.size();
+		for (const Task before : after)
+		{
+			nodes[before].dependents.push_back(task);
+		}
+		ready.reserve(nodes.size());
+		return task;
+	}
+
+	// A task of one part
+	Task Add(const char* name, std::function<void()> f, std::initializer_list<Task> after = {})
+	{
+		return Add(name, 1, [f](int, int) { f(); }, after);
+	}
+
+	int Tasks() const
+	{
+		return (int)nodes.size();
+	}
+
+	int Size() const final
+	{
+		return pool.Size();
+	}
+
+	// From a task, the chunks are taken by the caller and every thread of the graph that is free
+	// or gets free before they are gone. Outside of Run they go to the pool.
+	void RunChunks(const int chunks, void (*run)(void*, int), void* context) final
+	{
+		if (!running)
+		{
+			pool.RunChunks(chunks, run, context);
+			return;
+		}
+
+		Loop loop { run, context, chunks };
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			loops.push_back(&loop);
+		}
+		changed.notify_all();
+		for (int chunk = loop.next++; chunk < chunks; chunk = loop.next++)
+		{
+			run(context, chunk);
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		removeLoop(&loop);
+		changed.wait(lock, [&loop]() { return loop.helpers == 0; });
+	}
+
+	const char* Name(const Task task) const
+	{
+		return nodes[task].name;
+	}
+
+	// Runs every task once on the threads of the pool and returns when all of them are done
+	void Run()
+	{
+		ready.clear();
+		finished = 0;
+		for (Task task = 0; task < Tasks(); task++)
+		{
+			Node& node = nodes[task];
+			node.nextPart = 0;
+			node.partsLeft = node.parts;
+			node.waiting = node.dependencies;
+			if (node.waiting == 0)
+				ready.push_back(task);
+		}
+		start = std::chrono::steady_clock::now();
+		running = true;
+		pool.Run([this](const int thread) { Work(thread); });
+		running = false;
+	}
+
+	// When a task of the last Run started, after the start of the Run, and how long it took
+	float StartMs(const Task task) const
+	{
+		return nodes[task].startMs;
+	}
+
+	float Ms(const Task task) const
+	{
+		return nodes[task].ms;
+	}
+
+private:
+	struct Node
+	{
+		const char* name = "";
+		int parts = 1;
+		std::function<void(int, int)> f;
+		std::vector<Task> dependents;
+		int dependencies = 0;
+
+		// Where the last Run is with it
+		std::atomic<int> nextPart { 0 };
+		int partsLeft = 0;
+		int waiting = 0;
+		float startMs = 0;
+		float ms = 0;
+	};
+
+	// A parallel loop of a running task, on the stack of the thread that runs it
+	struct Loop
+	{
+		void (*run)(void*, int);
+		void* context;
+		int chunks;
+		std::atomic<int> next { 0 };
+		// Threads other than the caller still in it
+		int helpers = 0;
+	};
+
+	float msSince(const std::chrono::steady_clock::time_point since) const
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - since).count();
+	}
+
+	// Under the lock
+	void removeLoop(const Loop* loop)
+	{
+		const auto found = std::find(loops.begin(), loops.end(), loop);
+		if (found != loops.end())
+			loops.erase(found);
+	}
+
+	void Work(const int thread)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			changed.wait(lock, [this]() { return !loops.empty() || finished == Tasks() || !ready.empty(); });
+
+			// Loops first, a task is waiting for them
+			if (!loops.empty())
+			{
+				Loop& loop = *loops.front();
+				loop.helpers++;
+				lock.unlock();
+				for (int chunk = loop.next++; chunk < loop.chunks; chunk = loop.next++)
+				{
+					loop.run(loop.context, chunk);
+				}
+				lock.lock();
+				removeLoop(&loop);
+				if (--loop.helpers == 0)
+					changed.notify_all();
+				continue;
+			}
+
+			if (finished == Tasks())
+				return;
+			const Task task = ready.front();
+			Node& node = nodes[task];
+			lock.unlock();
+
+			// Parts are taken without the lock, a thread that gets none finds the task used up
+			int done = 0;
+			for (int part = node.nextPart++; part < node.parts; part = node.nextPart++)
+			{
+				if (part == 0)
+					node.startMs = msSince(start);
+				node.f(part, thread);
+				done++;
+			}
+
+			lock.lock();
+			const auto found = std::find(ready.begin(), ready.end(), task);
+			if (found != ready.end())
+				ready.erase(found);
+			node.partsLeft -= done;
+			if (done > 0 && node.partsLeft == 0)
+			{
+				node.ms = msSince(start) - node.startMs;
+				finished++;
+				for (const Task next : node.dependents)
+				{
+					if (--nodes[next].waiting == 0)
+						ready.insert(std::upper_bound(ready.begin(), ready.end(), next), next);
+				}
+				changed.notify_all();
+			}
+		}
+	}
+
+	ThreadPool& pool;
+	// A deque so the nodes stay put, they hold atomics
+	std::deque<Node> nodes;
+	std::chrono::steady_clock::time_point start;
+
+	// Tasks that are ready and may have parts left, in the order they were added
+	std::vector<Task> ready;
+	int finished = 0;
+	std::atomic<bool> running { false };
+	// Loops of running tasks that may still have chunks left
+	std::vector<Loop*> loops;
+	std::mutex mutex;
+	std::condition_variable changed;
+};
+}
+
+#endif // UTIL_TASK_GRAPH_HPP
@@ -0,0 +1,161 @@
+#ifndef UTIL_THREAD_POOL_HPP
+#define UTIL_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Utility/Parallel.hpp"
+#include "Utility/Topology.hpp"
+
+namespace util
+{
+// Worker threads started once and parked on a condition variable (a futex on Linux) between
+// jobs, so a frame only pays for waking them instead of creating and joining threads. Parallel
+// loops such as the BVH builds run on it too.
+class ThreadPool : public Workers
+{
+public:
+	// numThreads counts the calling thread, which works along in Run. With cpus, worker t stays
+	// on cpus[t % size] and whichever thread calls Run on cpus[0], so thread t always works from
+	// the same CPU and the memory it first touched.
+	explicit ThreadPool(const int numThreads, const std::vector<int>& cpus = {}) :
+		callerCpu(cpus.empty() ? -1 : cpus[0])
+	{
+		for (int t = 1; t < std::max(1, numThreads); t++)
+		{
+			const int cpu = cpus.empty() ? -1 : cpus[t % cpus.size()];
+			workers.emplace_back([this, t, cpu]() {
+				if (cpu >= 0)
+					PinThread(cpu);
+				Work(t);
+			});
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int Size() const final
+	{
+		return (int)workers.size() + 1;
+	}
+
+	// Every thread takes the next chunk until none are left. Run can't be nested, so called from
+	// a job of this pool the calling thread does all the chunks itself.
+	void RunChunks(const int chunks, void (*run)(void*, int), void* context) final
+	{
+		if (Current() == this)
+		{
+			for (int chunk = 0; chunk < chunks; chunk++)
+			{
+				run(context, chunk);
+			}
+			return;
+		}
+		std::atomic<int> next { 0 };
+		Run([&](int) {
+			for (int chunk = next++; chunk < chunks; chunk = next++)
+			{
+				run(context, chunk);
+			}
+		});
+	}
+
+	// Calls f(thread) once on every thread of the pool, thread 0 being the caller, and returns
+	// when all of them are done. f lives on the caller's stack, nothing is allocated.
+	template <typename F>
+	void Run(F&& f)
+	{
+		if (callerCpu >= 0 && std::this_thread::get_id() != pinnedCaller)
+		{
+			PinThread(callerCpu);
+			pinnedCaller = std::this_thread::get_id();
+		}
+		const ThreadPool* const caller = Current();
+		Current() = this;
+		if (workers.empty())
+		{
+			f(0);
+			Current() = caller;
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = [](void* callable, const int thread) { (*static_cast<std::remove_reference_t<F>*>(callable))(thread); };
+			context = const_cast<void*>(static_cast<const void*>(&f));
+			pending = (int)workers.size();
+			generation++;
+		}
+		wake.notify_all();
+		f(0);
+		Current() = caller;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return pending == 0; });
+	}
+
+private:
+	// The pool whose job the calling thread is in, if any
+	static const ThreadPool*& Current()
+	{
+		static thread_local const ThreadPool* current = nullptr;
+		return current;
+	}
+
+	void Work(const int thread)
+	{
+		Current() = this;
+		uint64_t seen = 0;
+		while (true)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+			void (*const call)(void*, int) = job;
+			void* const callContext = context;
+			lock.unlock();
+
+			call(callContext, thread);
+
+			lock.lock();
+			if (--pending == 0)
+				done.notify_one();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	int callerCpu;
+	std::thread::id pinnedCaller;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	void (*job)(void*, int) = nullptr;
+	void* context = nullptr;
+	uint64_t generation = 0;
+	int pending = 0;
+	bool stopping = false;
+};
+}
+
+#endif // UTIL_THREAD_POOL_HPP
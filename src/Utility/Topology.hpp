@@ -0,0 +1,102 @@
+#ifndef UTIL_TOPOLOGY_HPP
+#define UTIL_TOPOLOGY_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+#include "Constants.h"
+
+namespace util
+{
+// Cores a cgroup v2 cpu.max line ("<quota> <period>" or "max <period>") allows, 0 for no limit
+inline int ParseCpuMax(const std::string& line)
+{
+	std::istringstream in(line);
+	std::string quota;
+	double period = 0;
+	if (!(in >> quota >> period) || quota == "max" || period <= 0)
+		return 0;
+	return std::max(1, (int)std::ceil(std::stod(quota) / period));
+}
+
+// Same for cgroup v1's cpu.cfs_quota_us and cpu.cfs_period_us, where a quota of -1 means no limit
+inline int ParseCfsQuota(const long long quota, const long long period)
+{
+	if (quota <= 0 || period <= 0)
+		return 0;
+	return std::max(1, (int)((quota + period - 1) / period));
+}
+
+// The CPU time a container gets, in cores, 0 if unlimited or not in a cgroup
+inline int CpuQuota()
+{
+	std::string line;
+	if (std::getline(std::ifstream("/sys/fs/cgroup/cpu.max"), line))
+		return ParseCpuMax(line);
+	long long quota = 0, period = 0;
+	std::ifstream("/sys/fs/cgroup/cpu/cpu.cfs_quota_us") >> quota;
+	std::ifstream("/sys/fs/cgroup/cpu/cpu.cfs_period_us") >> period;
+	return ParseCfsQuota(quota, period);
+}
+
+// CPUs this process may run on, in order
+inline std::vector<int> AllowedCpus()
+{
+	std::vector<int> cpus;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &set))
+				cpus.push_back(cpu);
+		}
+	}
+#endif
+	if (cpus.empty())
+	{
+		const int count = std::thread::hardware_concurrency() > 0 ? (int)std::thread::hardware_concurrency() : NUM_THREADS;
+		for (int cpu = 0; cpu < count; cpu++)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+// Threads worth running: the CPUs we may use, or fewer if the cgroup quota says so
+inline int CoreCount()
+{
+	const int cpus = (int)AllowedCpus().size();
+	const int quota = CpuQuota();
+	return quota > 0 ? std::min(cpus, quota) : cpus;
+}
+
+// Keeps the calling thread on one CPU, false where that isn't supported
+inline bool PinThread(const int cpu)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+}
+
+#endif // UTIL_TOPOLOGY_HPP
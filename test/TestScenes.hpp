@@ -0,0 +1,55 @@
+#ifndef TEST_SCENES_HPP
+#define TEST_SCENES_HPP
+
+#include <cstdlib>
+#include <vector>
+
+#include "Constants.h"
+#include "Scene.hpp"
+
+namespace test
+{
+inline float random01()
+{
+	return (rand() % 10000) / 10000.0f;
+}
+
+// Small spheres spread through the whole view volume
+inline std::vector<Sphere> randomSpheres(const int count)
+{
+	std::vector<Sphere> spheres;
+	for (int i = 0; i < count; i++)
+	{
+		const auto pos = Vec3f(-5.0f + 10.0f * random01(), -3.0f + 6.0f * random01(), -10.0f - 20.0f * random01());
+		spheres.push_back(Sphere(pos, 0.05f + 0.3f * random01(), Color(rand() % 255, rand() % 255, rand() % 255), Vec3f(0)));
+	}
+	return spheres;
+}
+
+inline Vec3f randomDirection()
+{
+	Vec3f dir(-0.5f + random01(), -0.3f + 0.6f * random01(), -1.0f);
+	dir.normalize();
+	return dir;
+}
+
+// Camera rays through every step-th pixel of the window (same camera as the raytracer)
+inline std::vector<Vec3f> primaryDirections(const int step)
+{
+	const float scale = 0.46f;
+	const float aspectRatio = WINDOW_WIDTH / (float)WINDOW_HEIGHT;
+	std::vector<Vec3f> directions;
+	for (int j = 0; j < WINDOW_HEIGHT; j += step)
+	{
+		for (int i = 0; i < WINDOW_WIDTH; i += step)
+		{
+			Vec3f dir((2 * (i + 0.5f) / WINDOW_WIDTH - 1) * aspectRatio * scale, (1 - 2 * (j + 0.5f) / WINDOW_HEIGHT) * scale, -1);
+			dir.normalize();
+			directions.push_back(dir);
+		}
+	}
+	return directions;
+}
+}
+
+#endif // TEST_SCENES_HPP
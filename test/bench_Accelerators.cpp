@@ -0,0 +1,314 @@
+#include <catch2/catch.hpp>
+#include <iostream>
+
+#include "Accel/Accelerator.hpp"
+#include "Accel/Instancing.hpp"
+#include "TestScenes.hpp"
+#include "Utility/ThreadPool.hpp"
+
+// Run with: tests_<name> "[benchmark]"
+namespace
+{
+float traceAll(const IRayQuery& accelerator, const std::vector<Vec3f>& directions)
+{
+	float sum = 0.0f;
+	for (const auto& dir : directions)
+	{
+		sum += accelerator.Intersect(Vec3f(0), dir).distance;
+	}
+	return sum;
+}
+
+// Runs of N neighbouring camera rays traced as packets
+template <int N>
+float tracePackets(const BVH& bvh, const std::vector<Vec3f>& directions)
+{
+	float sum = 0.0f;
+	RayHit hits[N];
+	for (size_t i = 0; i + N <= directions.size(); i += N)
+	{
+		RayPacket<N> packet;
+		for (int j = 0; j < N; j++)
+		{
+			packet.Set(j, Vec3f(0), directions[i + j], 1000.0f);
+		}
+		bvh.ClosestHits(packet, hits);
+		for (int j = 0; j < N; j++)
+		{
+			sum += hits[j].distance;
+		}
+	}
+	return sum;
+}
+
+void benchmarkAccelerators(const std::vector<Sphere>& spheres, const std::vector<AccelType>& types, const int pixelStep = 4)
+{
+	const auto directions = test::primaryDirections(pixelStep);
+	for (const auto type : types)
+	{
+		auto accelerator = CreateAccelerator(type, (int)spheres.size());
+		accelerator->Build(spheres);
+		BENCHMARK(std::string(accelerator->Name()) + " " + std::to_string(directions.size()) + " rays")
+		{
+			return traceAll(*accelerator, directions);
+		};
+	}
+}
+}
+
+TEST_CASE("Closest hit, default 8 sphere scene", "[.][benchmark]")
+{
+	srand(1);
+	benchmarkAccelerators(GenerateSpheres(8), { AccelType::BruteForce, AccelType::BVH, AccelType::BVH4, AccelType::BVH8 });
+}
+
+TEST_CASE("Closest hit, 100k sphere scene", "[.][benchmark]")
+{
+	srand(1);
+	benchmarkAccelerators(test::randomSpheres(100000), { AccelType::BVH, AccelType::LBVH, AccelType::BVH4, AccelType::BVH8, AccelType::QBVH8, AccelType::QBVH16 });
+}
+
+TEST_CASE("Closest hit, uniform 5k sphere cloud", "[.][benchmark]")
+{
+	srand(1);
+	benchmarkAccelerators(test::randomSpheres(5000), { AccelType::BruteForce, AccelType::Grid, AccelType::HashGrid, AccelType::BVH }, 8);
+}
+
+TEST_CASE("Build, uniform 100k sphere cloud", "[.][benchmark]")
+{
+	srand(1);
+	const auto spheres = test::randomSpheres(100000);
+	for (const auto type : { AccelType::Grid, AccelType::HashGrid, AccelType::BVH, AccelType::LBVH })
+	{
+		auto accelerator = CreateAccelerator(type, (int)spheres.size());
+		BENCHMARK(std::string(accelerator->Name()) + " build")
+		{
+			accelerator->Build(spheres);
+			return accelerator.get();
+		};
+	}
+}
+
+TEST_CASE("Parallel BVH build, 1M spheres", "[.][benchmark]")
+{
+	srand(1);
+	const auto spheres = test::randomSpheres(1000000);
+	for (const int threads : { 1, 2, 4, 8 })
+	{
+		util::ThreadPool pool(threads);
+		BVH bvh(&pool);
+		BENCHMARK("bvh build " + std::to_string(threads) + " threads")
+		{
+			bvh.Build(spheres);
+			return bvh.Nodes().size();
+		};
+	}
+}
+
+TEST_CASE("Linear BVH build, 1M spheres", "[.][benchmark]")
+{
+	srand(1);
+	const auto spheres = test::randomSpheres(1000000);
+	for (const int bits : { 30, 63 })
+	{
+		for (const int threads : { 1, 8 })
+		{
+			util::ThreadPool pool(threads);
+			BVH lbvh(&pool, BVHBuilder::Morton);
+			lbvh.mortonBits = bits;
+			BENCHMARK("lbvh build " + std::to_string(bits) + " bit " + std::to_string(threads) + " threads")
+			{
+				lbvh.Build(spheres);
+				return lbvh.Nodes().size();
+			};
+		}
+	}
+}
+
+TEST_CASE("Instanced vs flattened, 500 instances of 200 spheres", "[.][benchmark]")
+{
+	srand(1);
+	const auto cluster = std::make_shared<const BottomLevel>(GenerateCluster(200), AccelType::BVH);
+	std::vector<Instance> instances;
+	std::vector<Sphere> flat;
+	for (int i = 0; i < 500; i++)
+	{
+		const auto pos = Vec3f(-5.0f + 10.0f * test::random01(), -3.0f + 6.0f * test::random01(), -10.0f - 20.0f * test::random01());
+		instances.push_back(Instance(cluster, InstanceTransform(pos, 6.28f * test::random01(), 0.5f)));
+		for (auto sphere : cluster->spheres)
+		{
+			Vec3f world;
+			instances.back().objectToWorld.multVecMatrix(sphere.position, world);
+			sphere.position = world;
+			sphere.radius *= 0.5f;
+			flat.push_back(sphere);
+		}
+	}
+
+	TwoLevelBVH instanced;
+	BVH bvh;
+	BENCHMARK("top level build")
+	{
+		instanced.Build(instances);
+		return instanced.TopLevel().Nodes().size();
+	};
+	BENCHMARK("flattened bvh build")
+	{
+		bvh.Build(flat);
+		return bvh.Nodes().size();
+	};
+
+	const auto directions = test::primaryDirections(4);
+	BENCHMARK("instances " + std::to_string(directions.size()) + " rays")
+	{
+		return traceAll(instanced, directions);
+	};
+	BENCHMARK("flattened bvh " + std::to_string(directions.size()) + " rays")
+	{
+		return traceAll(bvh, directions);
+	};
+}
+
+TEST_CASE("Memory per sphere and closest hit, 1M spheres", "[.][benchmark]")
+{
+	srand(1);
+	const auto spheres = test::randomSpheres(1000000);
+	util::ThreadPool pool(8);
+	BVH binary(&pool, BVHBuilder::Morton);
+	BVH4 bvh4(&pool, BVHBuilder::Morton);
+	QBVH8 qbvh8(&pool, BVHBuilder::Morton);
+	QBVH16 qbvh16(&pool, BVHBuilder::Morton);
+	binary.Build(spheres);
+	bvh4.Build(spheres);
+	qbvh8.Build(spheres);
+	qbvh16.Build(spheres);
+	std::cout << "bytes per sphere: bvh " << binary.MemoryBytes() / (float)spheres.size()
+			  << ", bvh4 " << bvh4.MemoryBytes() / (float)spheres.size()
+			  << ", qbvh " << qbvh8.MemoryBytes() / (float)spheres.size()
+			  << ", qbvh16 " << qbvh16.MemoryBytes() / (float)spheres.size() << std::endl;
+
+	const auto directions = test::primaryDirections(4);
+	for (const IAccelerator* accelerator : std::initializer_list<const IAccelerator*> { &binary, &bvh4, &qbvh8, &qbvh16 })
+	{
+		BENCHMARK(std::string(accelerator->Name()) + " " + std::to_string(directions.size()) + " rays")
+		{
+			return traceAll(*accelerator, directions);
+		};
+	}
+}
+
+TEST_CASE("Shadow rays, 100k sphere scene", "[.][benchmark]")
+{
+	srand(1);
+	const auto spheres = test::randomSpheres(100000);
+	const Vec3f light(0, 10, -15);
+	const auto directions = test::primaryDirections(4);
+	for (const auto type : { AccelType::BVH, AccelType::BVH8, AccelType::Grid })
+	{
+		auto accelerator = CreateAccelerator(type, (int)spheres.size());
+		accelerator->Build(spheres);
+
+		// Shadow rays from every primary hit towards the light
+		std::vector<std::pair<Vec3f, Vec3f>> shadowRays;
+		std::vector<float> lightDistances;
+		for (const auto& dir : directions)
+		{
+			const auto hit = accelerator->Intersect(Vec3f(0), dir);
+			if (hit.distance <= 0)
+				continue;
+			const Vec3f orig = hit.position + hit.normal * SHADOW_BIAS;
+			Vec3f toLight = light - orig;
+			lightDistances.push_back(toLight.length());
+			toLight.normalize();
+			shadowRays.push_back({ orig, toLight });
+		}
+
+		const std::string name = std::string(accelerator->Name()) + " " + std::to_string(shadowRays.size()) + " shadow rays";
+		BENCHMARK(name + ", closest hit")
+		{
+			int blocked = 0;
+			for (size_t i = 0; i < shadowRays.size(); i++)
+			{
+				const float distance = accelerator->Intersect(shadowRays[i].first, shadowRays[i].second).distance;
+				blocked += distance > 0 && distance < lightDistances[i];
+			}
+			return blocked;
+		};
+		BENCHMARK(name + ", occlusion")
+		{
+			int blocked = 0;
+			for (size_t i = 0; i < shadowRays.size(); i++)
+			{
+				blocked += accelerator->Occluded(shadowRays[i].first, shadowRays[i].second, lightDistances[i]);
+			}
+			return blocked;
+		};
+	}
+}
+
+TEST_CASE("SoA sphere kernel vs sphere loop", "[.][benchmark]")
+{
+	const auto directions = test::primaryDirections(4);
+	for (const int count : { 8, 64, 1000 })
+	{
+		srand(1);
+		const auto spheres = test::randomSpheres(count);
+		SphereSoA soa;
+		soa.Build(spheres);
+
+		const std::string name = std::to_string(count) + " spheres, " + std::to_string(directions.size()) + " rays";
+		BENCHMARK(name + ", sphere loop")
+		{
+			float sum = 0.0f;
+			for (const auto& dir : directions)
+			{
+				float closest = 1e6;
+				for (const auto& sphere : spheres)
+				{
+					const float distance = sphere.HitDistance(Vec3f(0), dir);
+					if (distance > 0 && distance < closest)
+						closest = distance;
+				}
+				sum += closest;
+			}
+			return sum;
+		};
+		BENCHMARK(name + ", " + util::IsaName(soa.Isa()) + " kernel")
+		{
+			float sum = 0.0f;
+			for (const auto& dir : directions)
+			{
+				const auto hit = soa.Closest(Vec3f(0), dir, 1e6);
+				sum += hit.prim >= 0 ? hit.distance : 1e6f;
+			}
+			return sum;
+		};
+	}
+}
+
+TEST_CASE("Primary ray packets, 100k sphere scene", "[.][benchmark]")
+{
+	srand(1);
+	const auto spheres = test::randomSpheres(100000);
+	const auto directions = test::primaryDirections(2);
+	BVH bvh;
+	bvh.Build(spheres);
+
+	const std::string rays = std::to_string(directions.size()) + " rays";
+	BENCHMARK("bvh " + rays + ", single rays")
+	{
+		return traceAll(bvh, directions);
+	};
+	BENCHMARK("bvh " + rays + ", packets of 4")
+	{
+		return tracePackets<4>(bvh, directions);
+	};
+	BENCHMARK("bvh " + rays + ", packets of 8")
+	{
+		return tracePackets<8>(bvh, directions);
+	};
+	BENCHMARK("bvh " + rays + ", packets of 16")
+	{
+		return tracePackets<16>(bvh, directions);
+	};
+}
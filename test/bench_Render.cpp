@@ -0,0 +1,70 @@
+#include <catch2/catch.hpp>
+
+#include "Render/Framebuffer.hpp"
+#include "TestScenes.hpp"
+#include "Utility/TaskGraph.hpp"
+#include "Utility/ThreadPool.hpp"
+
+// Run with: tests_<name> "[benchmark]"
+TEST_CASE("Framebuffer tonemap, one frame", "[.][benchmark]")
+{
+	srand(1);
+	const framebuffer::Curve curve(framebuffer::Tonemap {});
+	const int count = WINDOW_WIDTH * WINDOW_HEIGHT;
+	std::vector<Color> colors(count);
+	for (auto& color : colors)
+	{
+		color = Color(rand() % 1000, rand() % 1000, rand() % 1000);
+	}
+	std::vector<uint8_t> pixels(count * 4);
+	for (const auto& conversion : framebuffer::Conversions())
+	{
+		if (!util::Supports(conversion.isa))
+			continue;
+		BENCHMARK(std::string(util::IsaName(conversion.isa)) + " " + std::to_string(count) + " pixels")
+		{
+			conversion.toRGBA(colors.data(), count, curve, pixels.data());
+			return pixels[count / 2];
+		};
+	}
+}
+
+// What a frame pays to get NUM_THREADS threads going and back, without any work
+TEST_CASE("Scheduling an empty frame", "[.][benchmark]")
+{
+	BENCHMARK("New threads every frame")
+	{
+		std::vector<std::thread> workers;
+		for (int i = 0; i < NUM_THREADS; i++)
+		{
+			workers.emplace_back([]() {});
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		return workers.size();
+	};
+
+	util::ThreadPool pool(NUM_THREADS);
+	BENCHMARK("Persistent pool")
+	{
+		pool.Run([](int) {});
+		return pool.Size();
+	};
+
+	// Shaped like the renderer's frame: rays and snapshot, then simulate, build and trace, then
+	// resolve
+	util::TaskGraph graph(pool);
+	const auto rays = graph.Add("rays", NUM_THREADS, [](int, int) {});
+	const auto snapshot = graph.Add("snapshot", []() {});
+	const auto simulate = graph.Add("simulate", []() {}, { snapshot });
+	graph.Add("build", []() {}, { simulate });
+	const auto trace = graph.Add("trace", NUM_THREADS, [](int, int) {}, { rays, snapshot });
+	graph.Add("resolve", []() {}, { trace });
+	BENCHMARK("Frame graph on the pool")
+	{
+		graph.Run();
+		return graph.Tasks();
+	};
+}
@@ -0,0 +1,129 @@
+#include <catch2/catch.hpp>
+
+#include "Render/Accumulation.hpp"
+#include "Render/Framebuffer.hpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+TEST_CASE("Half conversions round to nearest even", "[accumulation]")
+{
+	REQUIRE(util::FloatToHalf(0.0f) == 0x0000);
+	REQUIRE(util::FloatToHalf(-0.0f) == 0x8000);
+	REQUIRE(util::FloatToHalf(1.0f) == 0x3c00);
+	REQUIRE(util::FloatToHalf(65504.0f) == 0x7bff);
+	REQUIRE(util::FloatToHalf(65520.0f) == 0x7c00);
+	REQUIRE(util::FloatToHalf(std::ldexp(1.0f, -24)) == 0x0001);
+	// Ties go to the even mantissa
+	REQUIRE(util::FloatToHalf(1.0f + std::ldexp(1.0f, -11)) == 0x3c00);
+	REQUIRE(util::FloatToHalf(1.0f + 3 * std::ldexp(1.0f, -11)) == 0x3c02);
+
+	// Every half but NaN comes back as itself
+	for (int h = 0; h < 0x10000; h++)
+	{
+		if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff))
+			continue;
+		REQUIRE(util::FloatToHalf(util::HalfToFloat((uint16_t)h)) == h);
+	}
+}
+
+TEST_CASE("Every half blend matches the scalar one", "[accumulation]")
+{
+	srand(43);
+	for (const auto& blend : accumulation::Blends())
+	{
+		if (!util::Supports(blend.isa))
+			continue;
+		INFO(util::IsaName(blend.isa));
+		// Lengths around the 4 and 8 float steps, so the scalar tail is covered too
+		for (int count = 0; count <= 40; count++)
+		{
+			std::vector<float> frame(count);
+			std::vector<uint16_t> history(count);
+			for (int i = 0; i < count; i++)
+			{
+				// Denormals, everyday radiance and values that overflow to infinity
+				frame[i] = std::ldexp(random01(), rand() % 40 - 24);
+				history[i] = util::FloatToHalf(random01() * 1000);
+			}
+			std::vector<float> expectedFrame = frame;
+			std::vector<uint16_t> expectedHistory = history;
+			const float weight = 1.0f / (1 + rand() % 64);
+			accumulation::scalar::BlendHalf(expectedFrame.data(), expectedHistory.data(), count, weight);
+			blend.blendHalf(frame.data(), history.data(), count, weight);
+			REQUIRE(history == expectedHistory);
+			REQUIRE(std::equal(frame.begin(), frame.end(), expectedFrame.begin(), [](float a, float b) { return a == b || (a != a && b != b); }));
+		}
+	}
+	REQUIRE(util::Supports(accumulation::BestBlend().isa));
+}
+
+TEST_CASE("Accumulators average the frames added since a reset", "[accumulation]")
+{
+	for (const auto precision : { accumulation::Precision::Float, accumulation::Precision::Half })
+	{
+		INFO(accumulation::PrecisionName(precision));
+		Accumulator accumulator(precision);
+		std::vector<Color> frame { Color(1, 2, 4), Color(8, 16, 32) };
+		accumulator.Add(frame.data(), 2);
+		REQUIRE((frame[1].r == 8 && frame[1].g == 16 && frame[1].b == 32));
+
+		frame = { Color(3, 2, 0), Color(0, 0, 0) };
+		accumulator.Add(frame.data(), 2);
+		REQUIRE(accumulator.Frames() == 2);
+		REQUIRE((frame[0].r == 2 && frame[0].g == 2 && frame[0].b == 2));
+		REQUIRE((frame[1].r == 4 && frame[1].g == 8 && frame[1].b == 16));
+		REQUIRE(accumulator.Bytes() == 6 * (precision == accumulation::Precision::Half ? 2 : 4));
+
+		// The next frame after a reset is taken as it is
+		accumulator.Reset();
+		frame = { Color(5, 6, 7), Color(0, 0, 0) };
+		accumulator.Add(frame.data(), 2);
+		REQUIRE((frame[0].r == 5 && frame[0].g == 6 && frame[0].b == 7));
+	}
+}
+
+TEST_CASE("Half precision history stays within a display step of fp32", "[accumulation]")
+{
+	srand(47);
+	const int count = 4096;
+	std::vector<Color> base(count);
+	for (auto& color : base)
+	{
+		color = Color(random01() * 1500, random01() * 255, random01() * 2);
+	}
+
+	Accumulator exact(accumulation::Precision::Float);
+	Accumulator half(accumulation::Precision::Half);
+	std::vector<Color> a(count), b(count);
+	for (int frame = 0; frame < 256; frame++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			// Noise of up to +-50% around every pixel's radiance
+			a[i] = base[i] * (0.5f + random01());
+		}
+		b = a;
+		exact.Add(a.data(), count);
+		half.Add(b.data(), count);
+	}
+
+	float worst = 0;
+	for (int i = 0; i < count; i++)
+	{
+		for (const auto& [x, y] : { std::pair { a[i].r, b[i].r }, std::pair { a[i].g, b[i].g }, std::pair { a[i].b, b[i].b } })
+		{
+			worst = std::max(worst, std::abs(x - y) / x);
+		}
+	}
+	INFO("Largest relative error " << worst);
+	REQUIRE(worst < 0.02f);
+
+	std::vector<uint8_t> exactPixels(count * 4), halfPixels(count * 4);
+	framebuffer::ToRGBA(a.data(), count, framebuffer::Tonemap {}, exactPixels.data());
+	framebuffer::ToRGBA(b.data(), count, framebuffer::Tonemap {}, halfPixels.data());
+	for (int i = 0; i < count * 4; i++)
+	{
+		REQUIRE(std::abs(exactPixels[i] - halfPixels[i]) <= 1);
+	}
+}
@@ -0,0 +1,285 @@
+#include <catch2/catch.hpp>
+
+#include "Accel/BVH.hpp"
+#include "Accel/BruteForce.hpp"
+#include "Accel/QuantizedBVH.hpp"
+#include "Accel/WideBVH.hpp"
+#include "TestScenes.hpp"
+#include "Utility/ThreadPool.hpp"
+
+using namespace test;
+
+TEST_CASE("BVH matches brute force closest hits", "[bvh]")
+{
+	srand(42);
+	for (const int count : { 1, 8, 100, 2000 })
+	{
+		const auto spheres = randomSpheres(count);
+		BruteForce brute;
+		BVH bvh;
+		brute.Build(spheres);
+		bvh.Build(spheres);
+
+		for (int i = 0; i < 2000; i++)
+		{
+			const auto dir = randomDirection();
+			const auto expected = brute.Intersect(Vec3f(0), dir);
+			const auto actual = bvh.Intersect(Vec3f(0), dir);
+			REQUIRE(actual.distance == Approx(expected.distance));
+
+			// The closest phase names the sphere, shading it gives the same record as before the split
+			const auto closest = bvh.Closest(Vec3f(0), dir);
+			REQUIRE(closest.prim == brute.Closest(Vec3f(0), dir).prim);
+			if (closest.distance > 0)
+			{
+				const auto reference = spheres[closest.prim].RayIntersection(Vec3f(0), dir);
+				REQUIRE(actual.distance == reference.distance);
+				REQUIRE((actual.normal - reference.normal).length() == 0.0f);
+				REQUIRE(actual.color.r == reference.color.r);
+			}
+		}
+	}
+}
+
+TEST_CASE("BVH references every sphere exactly once", "[bvh]")
+{
+	srand(7);
+	const auto spheres = randomSpheres(1000);
+	BVH bvh;
+	bvh.Build(spheres);
+
+	std::vector<int> seen(spheres.size(), 0);
+	for (const auto& node : bvh.Nodes())
+	{
+		if (!node.IsLeaf())
+			continue;
+		REQUIRE(node.count <= BVH::MAX_LEAF_SIZE);
+		for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+		{
+			seen[bvh.Indices()[i]]++;
+			REQUIRE(!node.bounds.Empty());
+		}
+	}
+	REQUIRE(std::count(seen.begin(), seen.end(), 1) == (int)spheres.size());
+}
+
+TEST_CASE("Refitted BVH stays correct and rebuilds once degraded", "[bvh]")
+{
+	srand(3);
+	auto spheres = randomSpheres(500);
+	for (auto& sphere : spheres)
+	{
+		sphere.velocity = Vec3f(-1.0f + 2.0f * random01(), -1.0f + 2.0f * random01(), -1.0f + 2.0f * random01());
+	}
+
+	BruteForce brute;
+	BVH bvh;
+	bvh.rebuildThreshold = 1e9f;
+	brute.Build(spheres);
+	bvh.Build(spheres);
+	const float builtCost = bvh.SahCost();
+
+	for (int frame = 0; frame < 20; frame++)
+	{
+		for (auto& sphere : spheres)
+		{
+			sphere.Update(0.1f);
+		}
+		brute.Update(spheres);
+		bvh.Update(spheres);
+		for (int i = 0; i < 200; i++)
+		{
+			const auto dir = randomDirection();
+			REQUIRE(bvh.Intersect(Vec3f(0), dir).distance == Approx(brute.Intersect(Vec3f(0), dir).distance));
+		}
+	}
+	REQUIRE(bvh.Rebuilds() == 1);
+	REQUIRE(bvh.SahCost() > builtCost);
+
+	bvh.rebuildThreshold = 1.0f;
+	for (auto& sphere : spheres)
+	{
+		sphere.Update(0.1f);
+	}
+	bvh.Update(spheres);
+	REQUIRE(bvh.Rebuilds() == 2);
+}
+
+TEMPLATE_TEST_CASE("Wide BVH matches brute force closest hits", "[bvh]", BVH4, BVH8)
+{
+	srand(11);
+	for (const int count : { 1, 3, 8, 100, 5000 })
+	{
+		const auto spheres = randomSpheres(count);
+		BruteForce brute;
+		TestType wide;
+		brute.Build(spheres);
+		wide.Build(spheres);
+
+		for (int i = 0; i < 2000; i++)
+		{
+			const auto dir = randomDirection();
+			REQUIRE(wide.Intersect(Vec3f(0), dir).distance == Approx(brute.Intersect(Vec3f(0), dir).distance));
+		}
+	}
+}
+
+TEST_CASE("Parallel BVH build matches the sequential build", "[bvh]")
+{
+	srand(13);
+	const auto spheres = randomSpheres(50000);
+	util::ThreadPool pool(8);
+	BVH sequential;
+	BVH parallel(&pool);
+	sequential.Build(spheres);
+	parallel.Build(spheres);
+	REQUIRE(parallel.SahCost() == Approx(sequential.SahCost()).epsilon(0.05));
+
+	std::vector<int> seen(spheres.size(), 0);
+	for (const auto& node : parallel.Nodes())
+	{
+		if (node.IsLeaf())
+		{
+			for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				seen[parallel.Indices()[i]]++;
+			}
+		}
+	}
+	REQUIRE(std::count(seen.begin(), seen.end(), 1) == (int)spheres.size());
+
+	for (int i = 0; i < 2000; i++)
+	{
+		const auto dir = randomDirection();
+		REQUIRE(parallel.Intersect(Vec3f(0), dir).distance == Approx(sequential.Intersect(Vec3f(0), dir).distance));
+	}
+}
+
+TEST_CASE("Linear BVH matches brute force closest hits", "[bvh]")
+{
+	srand(21);
+	util::ThreadPool pool(4);
+	for (const int bits : { 30, 63 })
+	{
+		for (const int count : { 1, 2, 5, 100, 20000 })
+		{
+			const auto spheres = randomSpheres(count);
+			BruteForce brute;
+			BVH lbvh(count > 10000 ? &pool : nullptr, BVHBuilder::Morton);
+			lbvh.mortonBits = bits;
+			brute.Build(spheres);
+			lbvh.Build(spheres);
+
+			std::vector<int> seen(spheres.size(), 0);
+			for (const auto& node : lbvh.Nodes())
+			{
+				if (!node.IsLeaf())
+					continue;
+				REQUIRE(node.count <= BVH::MORTON_LEAF_SIZE);
+				for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+				{
+					seen[lbvh.Indices()[i]]++;
+				}
+			}
+			REQUIRE(std::count(seen.begin(), seen.end(), 1) == count);
+
+			for (int i = 0; i < 1000; i++)
+			{
+				const auto dir = randomDirection();
+				REQUIRE(lbvh.Intersect(Vec3f(0), dir).distance == Approx(brute.Intersect(Vec3f(0), dir).distance));
+			}
+		}
+	}
+}
+
+TEST_CASE("Linear BVH handles duplicate Morton codes", "[bvh]")
+{
+	srand(5);
+	// Many spheres sharing a center end up with identical codes
+	std::vector<Sphere> spheres = randomSpheres(64);
+	for (int i = 0; i < 300; i++)
+	{
+		spheres.push_back(spheres[i % 4]);
+	}
+	BruteForce brute;
+	BVH lbvh(nullptr, BVHBuilder::Morton);
+	brute.Build(spheres);
+	lbvh.Build(spheres);
+	for (int i = 0; i < 1000; i++)
+	{
+		const auto dir = randomDirection();
+		REQUIRE(lbvh.Intersect(Vec3f(0), dir).distance == Approx(brute.Intersect(Vec3f(0), dir).distance));
+	}
+}
+
+TEMPLATE_TEST_CASE("Quantized BVH matches brute force closest hits", "[bvh]", QBVH8, QBVH16)
+{
+	srand(9);
+	for (const int count : { 1, 3, 100, 5000 })
+	{
+		const auto spheres = randomSpheres(count);
+		BruteForce brute;
+		TestType quantized;
+		brute.Build(spheres);
+		quantized.Build(spheres);
+
+		for (int i = 0; i < 2000; i++)
+		{
+			const auto dir = randomDirection();
+			REQUIRE(quantized.Intersect(Vec3f(0), dir).distance == Approx(brute.Intersect(Vec3f(0), dir).distance));
+		}
+	}
+}
+
+TEMPLATE_TEST_CASE("Quantized BVH keeps every one of many coincident spheres", "[bvh]", QBVH8, QBVH16)
+{
+	// More spheres on one center than a 16 bit leaf count holds, the largest one comes last
+	std::vector<Sphere> spheres;
+	for (int i = 0; i < 70000; i++)
+	{
+		spheres.push_back(Sphere(Vec3f(0, 0, -10), 1.0f + i * 1e-5f, Color(255, 255, 255), Vec3f(0)));
+	}
+	BruteForce brute;
+	TestType quantized;
+	brute.Build(spheres);
+	quantized.Build(spheres);
+
+	for (const auto& node : quantized.Binary().Nodes())
+	{
+		if (node.IsLeaf())
+			REQUIRE(node.count <= BVH::MAX_LEAF_SIZE);
+	}
+	const auto expected = brute.Intersect(Vec3f(0), Vec3f(0, 0, -1));
+	REQUIRE(expected.distance == Approx(10.0f - spheres.back().radius));
+	REQUIRE(quantized.Intersect(Vec3f(0), Vec3f(0, 0, -1)).distance == Approx(expected.distance));
+}
+
+TEMPLATE_TEST_CASE("Quantized child bounds are conservative", "[bvh]", QBVH8, QBVH16)
+{
+	srand(19);
+	const auto spheres = randomSpheres(3000);
+	TestType quantized;
+	quantized.Build(spheres);
+
+	std::vector<WideBVHNode<4>> wide;
+	BVH4::Collapse(quantized.Binary(), wide);
+	REQUIRE(wide.size() == quantized.Nodes().size());
+	for (size_t n = 0; n < wide.size(); n++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			if (wide[n].count[i] < 0)
+				continue;
+			const AABB box = TestType::ChildBounds(quantized.Nodes()[n], i);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				REQUIRE(box.min[axis] <= wide[n].bounds[axis][i]);
+				REQUIRE(box.max[axis] >= wide[n].bounds[axis + 3][i]);
+			}
+		}
+	}
+
+	BVH4 uncompressed;
+	uncompressed.Build(spheres);
+	REQUIRE(quantized.MemoryBytes() < uncompressed.MemoryBytes());
+}
@@ -0,0 +1,62 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Utility/DoubleBuffer.hpp"
+
+TEST_CASE("Double buffer hands out the published copy and fills the other", "[doublebuffer]")
+{
+	util::DoubleBuffer<int> buffer;
+	buffer.Back() = 1;
+	buffer.Publish();
+	const int* first = buffer.Acquire();
+	REQUIRE(*first == 1);
+
+	// The writer gets the copy nobody holds, readers keep theirs through the next publish
+	int& back = buffer.Back();
+	REQUIRE(&back != first);
+	back = 2;
+	buffer.Publish();
+	REQUIRE(*first == 1);
+	const int* second = buffer.Acquire();
+	REQUIRE(*second == 2);
+	buffer.Release(first);
+	buffer.Release(second);
+}
+
+TEST_CASE("Double buffer never changes a copy under its readers", "[doublebuffer]")
+{
+	// Every element of a published copy holds the step that wrote it
+	util::DoubleBuffer<std::vector<int>> buffer;
+	buffer.Back().assign(1000, 0);
+	buffer.Publish();
+
+	std::atomic<bool> running { true };
+	std::thread writer([&]() {
+		for (int step = 1; running; step++)
+		{
+			buffer.Back().assign(1000, step);
+			buffer.Publish();
+		}
+	});
+
+	int torn = 0;
+	int previous = 0;
+	for (int frame = 0; frame < 2000; frame++)
+	{
+		const std::vector<int>* copy = buffer.Acquire();
+		const int step = copy->front();
+		for (const int value : *copy)
+		{
+			torn += value != step;
+		}
+		REQUIRE(step >= previous);
+		previous = step;
+		buffer.Release(copy);
+	}
+	running = false;
+	writer.join();
+	REQUIRE(torn == 0);
+}
@@ -0,0 +1,32 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+
+#include "Render/FramePipeline.hpp"
+
+TEST_CASE("Frame pipeline shows frames in order and stays within its depth", "[pipeline]")
+{
+	for (const int depth : { 1, 2, 3 })
+	{
+		INFO("depth " << depth);
+		std::atomic<uint64_t> shown { 0 };
+		std::atomic<uint64_t> furthestAhead { 0 };
+		{
+			FramePipeline<uint64_t> pipeline(depth, [&](uint64_t& frame, const uint64_t index) {
+				// Frames made but not shown yet, counting this one
+				furthestAhead = std::max<uint64_t>(furthestAhead, index + 1 - shown);
+				frame = index * 10;
+			});
+			REQUIRE(pipeline.Depth() == depth);
+			for (uint64_t i = 0; i < 300; i++)
+			{
+				REQUIRE(pipeline.Acquire() == i * 10);
+				REQUIRE(pipeline.WaitMs() >= 0);
+				shown++;
+				pipeline.Release();
+			}
+			// Leaving the scope stops the producer wherever it is
+		}
+		REQUIRE(furthestAhead <= (uint64_t)depth);
+	}
+}
@@ -0,0 +1,59 @@
+#include <catch2/catch.hpp>
+
+#include "Render/Framebuffer.hpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+TEST_CASE("Every tonemap variant matches the scalar one", "[framebuffer]")
+{
+	srand(41);
+	const framebuffer::Curve curve(framebuffer::Tonemap {});
+	for (const auto& conversion : framebuffer::Conversions())
+	{
+		if (!util::Supports(conversion.isa))
+			continue;
+		INFO(util::IsaName(conversion.isa));
+		// Lengths around the 4 and 8 pixel steps, so the scalar tail is covered too
+		for (int count = 0; count <= 40; count++)
+		{
+			// Radiance up to well past the white point
+			std::vector<Color> colors(count);
+			for (auto& color : colors)
+			{
+				color = Color(random01() * 1500, random01() * 300, random01() * 20);
+			}
+			std::vector<uint8_t> expected(count * 4 + 4, 7);
+			std::vector<uint8_t> actual(count * 4 + 4, 7);
+			framebuffer::scalar::ToRGBA(colors.data(), count, curve, expected.data());
+			conversion.toRGBA(colors.data(), count, curve, actual.data());
+			REQUIRE(actual == expected);
+		}
+	}
+	REQUIRE(util::Supports(framebuffer::BestConversion().isa));
+}
+
+TEST_CASE("Tonemap keeps black and white and never reverses brightness", "[framebuffer]")
+{
+	const framebuffer::Tonemap tonemap;
+	const framebuffer::Curve curve(tonemap);
+	REQUIRE(framebuffer::scalar::Channel(0, curve) == 0);
+	REQUIRE(framebuffer::scalar::Channel(tonemap.white * 255, curve) == 255);
+	REQUIRE(framebuffer::scalar::Channel(tonemap.white * 2550, curve) == 255);
+
+	int previous = 0;
+	for (float radiance = 0; radiance < tonemap.white * 255; radiance += 0.5f)
+	{
+		const int channel = framebuffer::scalar::Channel(radiance, curve);
+		REQUIRE(channel >= previous);
+		previous = channel;
+	}
+
+	uint8_t pixel[4];
+	const Color color(255, 1000, 0);
+	framebuffer::ToRGBA(&color, 1, tonemap, pixel);
+	// Highlights past 255 stay brighter than 255 itself
+	REQUIRE(pixel[0] < pixel[1]);
+	REQUIRE(pixel[2] == 0);
+	REQUIRE(pixel[3] == 255);
+}
@@ -0,0 +1,67 @@
+#include <catch2/catch.hpp>
+
+#include "Geometry.cpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+TEST_CASE("Float vectors keep three floats", "[geometry]")
+{
+	REQUIRE(sizeof(Vec3f) == 3 * sizeof(float));
+	REQUIRE(sizeof(Vec3i) == 3 * sizeof(int));
+}
+
+TEST_CASE("Float vector math matches the scalar formulas exactly", "[geometry]")
+{
+	srand(37);
+	const Matrix44f m = InstanceTransform(Vec3f(1, -2, 3), 0.7f, 1.5f);
+	const Matrix44f n = InstanceTransform(Vec3f(-4, 0.5f, 2), 2.1f, 0.8f);
+	for (int i = 0; i < 1000; i++)
+	{
+		const Vec3f a(random01() * 10 - 5, random01() * 10 - 5, random01() * 10 - 5);
+		const Vec3f b(random01() * 10 - 5, random01() * 10 - 5, random01() * 10 - 5);
+		const float f = random01() * 4 - 2;
+
+		const Vec3f sum = a + b;
+		const Vec3f difference = a - b;
+		const Vec3f scaled = a * f;
+		const Vec3f divided = a / 3.0f;
+		REQUIRE((sum.x == a.x + b.x && sum.y == a.y + b.y && sum.z == a.z + b.z));
+		REQUIRE((difference.x == a.x - b.x && difference.y == a.y - b.y && difference.z == a.z - b.z));
+		REQUIRE((scaled.x == a.x * f && scaled.y == a.y * f && scaled.z == a.z * f));
+		REQUIRE((divided.x == a.x / 3.0f && divided.y == a.y / 3.0f && divided.z == a.z / 3.0f));
+		REQUIRE(a.dotProduct(b) == a.x * b.x + a.y * b.y + a.z * b.z);
+		REQUIRE(a.length() == (float)std::sqrt((double)(a.x * a.x + a.y * a.y + a.z * a.z)));
+
+		const Vec3f cross = a.crossProduct(b);
+		REQUIRE(cross.x == a.y * b.z - a.z * b.y);
+		REQUIRE(cross.y == a.z * b.x - a.x * b.z);
+		REQUIRE(cross.z == a.x * b.y - a.y * b.x);
+
+		Vec3f unit = a;
+		unit.normalize();
+		const float inverse = 1 / a.length();
+		REQUIRE((unit.x == a.x * inverse && unit.y == a.y * inverse && unit.z == a.z * inverse));
+
+		Vec3f dir;
+		m.multDirMatrix(a, dir);
+		REQUIRE(dir.x == a.x * m.x[0][0] + a.y * m.x[1][0] + a.z * m.x[2][0]);
+		REQUIRE(dir.y == a.x * m.x[0][1] + a.y * m.x[1][1] + a.z * m.x[2][1]);
+		REQUIRE(dir.z == a.x * m.x[0][2] + a.y * m.x[1][2] + a.z * m.x[2][2]);
+
+		Vec3f point;
+		m.multVecMatrix(a, point);
+		const float w = a.x * m.x[0][3] + a.y * m.x[1][3] + a.z * m.x[2][3] + m.x[3][3];
+		REQUIRE(point.x == (a.x * m.x[0][0] + a.y * m.x[1][0] + a.z * m.x[2][0] + m.x[3][0]) / w);
+		REQUIRE(point.z == (a.x * m.x[0][2] + a.y * m.x[1][2] + a.z * m.x[2][2] + m.x[3][2]) / w);
+	}
+
+	const Matrix44f product = m * n;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			REQUIRE(product.x[i][j] == m.x[i][0] * n.x[0][j] + m.x[i][1] * n.x[1][j] + m.x[i][2] * n.x[2][j] + m.x[i][3] * n.x[3][j]);
+		}
+	}
+}
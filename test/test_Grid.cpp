@@ -0,0 +1,49 @@
+#include <catch2/catch.hpp>
+
+#include "Accel/BruteForce.hpp"
+#include "Accel/Grid.hpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+TEST_CASE("Grid matches brute force closest hits", "[grid]")
+{
+	srand(5);
+	for (const bool hashed : { false, true })
+	{
+		for (const int count : { 1, 8, 300, 5000 })
+		{
+			const auto spheres = randomSpheres(count);
+			BruteForce brute;
+			Grid grid(hashed);
+			brute.Build(spheres);
+			grid.Build(spheres);
+
+			for (int i = 0; i < 2000; i++)
+			{
+				const auto dir = randomDirection();
+				REQUIRE(grid.Intersect(Vec3f(0), dir).distance == Approx(brute.Intersect(Vec3f(0), dir).distance));
+			}
+		}
+	}
+}
+
+TEST_CASE("Grid handles rays starting inside and flat scenes", "[grid]")
+{
+	srand(9);
+	// Same layout as GenerateSpheres: every sphere centered on one plane
+	const auto spheres = GenerateSpheres(500);
+	BruteForce brute;
+	Grid grid;
+	brute.Build(spheres);
+	grid.Build(spheres);
+	REQUIRE(grid.Resolution(2) >= 1);
+
+	for (int i = 0; i < 2000; i++)
+	{
+		const Vec3f orig(-4.0f + 8.0f * random01(), -2.0f + 4.0f * random01(), -10.0f);
+		Vec3f dir(-1.0f + 2.0f * random01(), -1.0f + 2.0f * random01(), -1.0f + 2.0f * random01());
+		dir.normalize();
+		REQUIRE(grid.Intersect(orig, dir).distance == Approx(brute.Intersect(orig, dir).distance));
+	}
+}
@@ -0,0 +1,138 @@
+#include <catch2/catch.hpp>
+
+#include "Accel/BruteForce.hpp"
+#include "Accel/Instancing.hpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+namespace
+{
+// The flattened scene: every instance's spheres moved to world space, rigid transforms with
+// uniform scale map spheres to spheres
+std::vector<Sphere> flatten(const std::vector<Instance>& instances, const float scale)
+{
+	std::vector<Sphere> spheres;
+	for (const auto& instance : instances)
+	{
+		for (auto sphere : instance.object->spheres)
+		{
+			Vec3f world;
+			instance.objectToWorld.multVecMatrix(sphere.position, world);
+			sphere.position = world;
+			sphere.radius *= scale;
+			spheres.push_back(sphere);
+		}
+	}
+	return spheres;
+}
+}
+
+TEST_CASE("Matrix inverse undoes the transform", "[instancing]")
+{
+	const Matrix44f m = InstanceTransform(Vec3f(1, -2, 3), 0.7f, 1.5f);
+	const Matrix44f identity = m * m.inverse();
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			REQUIRE(identity.x[i][j] == Approx(i == j ? 1.0f : 0.0f).margin(1e-5));
+		}
+	}
+}
+
+TEST_CASE("Instanced scene matches the flattened scene", "[instancing]")
+{
+	srand(11);
+	const float scale = 0.8f;
+	const auto cluster = std::make_shared<const BottomLevel>(GenerateCluster(200), AccelType::BVH);
+	std::vector<Instance> instances;
+	for (int i = 0; i < 50; i++)
+	{
+		const auto pos = Vec3f(-5.0f + 10.0f * random01(), -3.0f + 6.0f * random01(), -10.0f - 20.0f * random01());
+		instances.push_back(Instance(cluster, InstanceTransform(pos, 6.28f * random01(), scale)));
+	}
+	TwoLevelBVH instanced;
+	instanced.Build(instances);
+
+	const auto spheres = flatten(instances, scale);
+	BruteForce brute;
+	brute.Build(spheres);
+
+	int hits = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		const auto dir = randomDirection();
+		const auto expected = brute.Intersect(Vec3f(0), dir);
+		const auto actual = instanced.Intersect(Vec3f(0), dir);
+
+		// Grazing hits may flip between hit and miss with the rounding of either space
+		const auto grazing = [&](const Collision& hit) { return hit.distance > 0 && -dir.dotProduct(hit.normal) < 0.2f; };
+		if (grazing(expected) || grazing(actual))
+			continue;
+		REQUIRE(actual.distance == Approx(expected.distance).epsilon(1e-3));
+		if (expected.distance > 0)
+		{
+			hits++;
+			REQUIRE(actual.normal.dotProduct(expected.normal) == Approx(1.0f).epsilon(1e-2));
+			REQUIRE((actual.position - expected.position).length() == Approx(0.0f).margin(1e-2));
+		}
+	}
+	REQUIRE(hits > 100);
+}
+
+TEST_CASE("Moving instances only rebuilds the top level", "[instancing]")
+{
+	srand(17);
+	const auto cluster = std::make_shared<const BottomLevel>(GenerateCluster(100), AccelType::BVH);
+	std::vector<Instance> instances;
+	for (int i = 0; i < 20; i++)
+	{
+		instances.push_back(Instance(cluster, InstanceTransform(Vec3f(-4.0f + 0.4f * i, 0, -15), 0)));
+	}
+	TwoLevelBVH instanced;
+	instanced.Build(instances);
+
+	// Non-uniform scale: normals have to stay perpendicular to the stretched surface
+	const Matrix44f stretch(2, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+	for (auto& instance : instances)
+	{
+		instance.SetTransform(stretch * InstanceTransform(Vec3f(0), 0.3f) * instance.objectToWorld);
+	}
+	instanced.Build(instances);
+	REQUIRE(static_cast<const BVH&>(*cluster->accelerator).Rebuilds() == 1);
+	REQUIRE(instanced.TopLevel().Rebuilds() == 2);
+
+	int hits = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		const auto dir = randomDirection();
+		const auto hit = instanced.Intersect(Vec3f(0), dir);
+		if (hit.distance <= 0)
+			continue;
+		hits++;
+
+		// The hit point lies on the surface of some transformed sphere
+		bool onSurface = false;
+		for (const auto& instance : instances)
+		{
+			Vec3f local;
+			instance.worldToObject.multVecMatrix(hit.position, local);
+			for (const auto& sphere : cluster->spheres)
+			{
+				if (std::fabs((local - sphere.position).length() - sphere.radius) < 1e-3f)
+				{
+					onSurface = true;
+					Vec3f localNormal = local - sphere.position;
+					localNormal.normalize();
+					Vec3f tangent = localNormal.crossProduct(Vec3f(0.3f, 1, 0.1f));
+					Vec3f worldTangent;
+					instance.objectToWorld.multDirMatrix(tangent, worldTangent);
+					REQUIRE(worldTangent.dotProduct(hit.normal) == Approx(0.0f).margin(1e-3));
+				}
+			}
+		}
+		REQUIRE(onSurface);
+	}
+	REQUIRE(hits > 100);
+}
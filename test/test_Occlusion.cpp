@@ -0,0 +1,55 @@
+#include <catch2/catch.hpp>
+
+#include "Accel/Accelerator.hpp"
+#include "Accel/Instancing.hpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+TEST_CASE("Occlusion agrees with closest hits for every accelerator", "[occlusion]")
+{
+	srand(23);
+	const auto spheres = randomSpheres(3000);
+	for (const auto type : { AccelType::BruteForce, AccelType::BVH, AccelType::LBVH, AccelType::BVH4, AccelType::BVH8, AccelType::QBVH8, AccelType::Grid, AccelType::HashGrid })
+	{
+		auto accelerator = CreateAccelerator(type, (int)spheres.size());
+		accelerator->Build(spheres);
+		int blocked = 0;
+		for (int i = 0; i < 2000; i++)
+		{
+			const auto dir = randomDirection();
+			const float maxDistance = 5.0f + 30.0f * random01();
+			const float closest = accelerator->Intersect(Vec3f(0), dir).distance;
+			const bool expected = closest > 0 && closest < maxDistance;
+			REQUIRE(accelerator->Occluded(Vec3f(0), dir, maxDistance) == expected);
+			blocked += expected;
+		}
+		REQUIRE(blocked > 100);
+		REQUIRE(blocked < 1900);
+	}
+}
+
+TEST_CASE("Occlusion through instances respects their scale", "[occlusion]")
+{
+	srand(29);
+	const auto cluster = std::make_shared<const BottomLevel>(GenerateCluster(100), AccelType::BVH);
+	std::vector<Instance> instances;
+	for (int i = 0; i < 30; i++)
+	{
+		const auto pos = Vec3f(-5.0f + 10.0f * random01(), -3.0f + 6.0f * random01(), -10.0f - 20.0f * random01());
+		instances.push_back(Instance(cluster, InstanceTransform(pos, 6.28f * random01(), 0.5f + random01())));
+	}
+	TwoLevelBVH instanced;
+	instanced.Build(instances);
+
+	for (int i = 0; i < 2000; i++)
+	{
+		const auto dir = randomDirection();
+		const float maxDistance = 5.0f + 30.0f * random01();
+		const float closest = instanced.Intersect(Vec3f(0), dir).distance;
+		// Skip rays whose hit is too close to the limit for both paths to round alike
+		if (std::fabs(closest - maxDistance) < 1e-3f)
+			continue;
+		REQUIRE(instanced.Occluded(Vec3f(0), dir, maxDistance) == (closest > 0 && closest < maxDistance));
+	}
+}
@@ -0,0 +1,88 @@
+#include <catch2/catch.hpp>
+
+#include "Accel/Accelerator.hpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+namespace
+{
+// Rays of one packet: neighbouring camera rays, or random ones that diverge
+template <int N>
+RayPacket<N> makePacket(const std::vector<Vec3f>& directions, const int first, const uint32_t active, const float maxDistance)
+{
+	RayPacket<N> packet;
+	for (int i = 0; i < N; i++)
+	{
+		if ((active >> i) & 1)
+			packet.Set(i, Vec3f(0), directions[first + i], maxDistance);
+	}
+	return packet;
+}
+}
+
+TEMPLATE_TEST_CASE_SIG("Packet traversal matches single rays", "[packet]", ((int N), N), 4, 8, 16)
+{
+	srand(37);
+	const auto spheres = randomSpheres(5000);
+	BVH bvh;
+	bvh.Build(spheres);
+
+	const auto coherent = primaryDirections(8);
+	const std::vector<Vec3f> divergent = [] {
+		std::vector<Vec3f> directions;
+		for (int i = 0; i < 4000; i++)
+		{
+			directions.push_back(i % 2 ? randomDirection() : randomDirection() * -1.0f);
+		}
+		return directions;
+	}();
+
+	int packets[2] = { 0, 0 }; // Traced as packets, traced as single rays
+	for (const auto* directions : { &coherent, &divergent })
+	{
+		for (int first = 0; first + N <= (int)directions->size(); first += N)
+		{
+			// Some packets with inactive lanes
+			const uint32_t all = (1u << N) - 1;
+			const uint32_t active = first % 3 == 0 ? all & (0x5555u | (uint32_t)first) : all;
+			const float maxDistance = 10.0f + (first % 20);
+			const auto packet = makePacket<N>(*directions, first, active, maxDistance);
+			packets[packet.Coherent() ? 0 : 1]++;
+
+			RayHit hits[N];
+			bvh.ClosestHits(packet, hits);
+			const uint32_t occluded = bvh.OccludedRays(packet);
+			for (int i = 0; i < N; i++)
+			{
+				if (!((active >> i) & 1))
+				{
+					REQUIRE(hits[i].prim == -1);
+					REQUIRE(!((occluded >> i) & 1));
+					continue;
+				}
+				const auto& dir = (*directions)[first + i];
+				const auto expected = bvh.Closest(Vec3f(0), dir);
+				const bool inRange = expected.distance > 0 && expected.distance < maxDistance;
+				REQUIRE(hits[i].prim == (inRange ? expected.prim : -1));
+				if (inRange)
+					REQUIRE(hits[i].distance == Approx(expected.distance));
+				REQUIRE(((occluded >> i) & 1) == (uint32_t)bvh.Occluded(Vec3f(0), dir, maxDistance));
+			}
+		}
+	}
+	// Both the packet traversal and the single ray fallback were taken
+	REQUIRE(packets[0] > 100);
+	REQUIRE(packets[1] > 100);
+}
+
+TEST_CASE("Ray packets need matching direction signs to be coherent", "[packet]")
+{
+	RayPacket<4> packet;
+	packet.Set(0, Vec3f(0), Vec3f(0.1f, 0.2f, -1.0f), 100);
+	REQUIRE_FALSE(packet.Coherent());
+	packet.Set(2, Vec3f(1), Vec3f(0.3f, 0.1f, -1.0f), 100);
+	REQUIRE(packet.Coherent());
+	packet.Set(3, Vec3f(0), Vec3f(-0.1f, 0.2f, -1.0f), 100);
+	REQUIRE_FALSE(packet.Coherent());
+}
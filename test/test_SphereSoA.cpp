@@ -0,0 +1,67 @@
+#include <catch2/catch.hpp>
+
+#include "Accel/SphereSoA.hpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+namespace
+{
+void checkKernel(const soa::Kernel& kernel)
+{
+	srand(31);
+	// Every count up to a few registers, so each tail length is covered
+	for (int count = 0; count <= 3 * kernel.width + 3; count++)
+	{
+		const auto spheres = randomSpheres(count);
+		SphereSoA soa(kernel);
+		soa.Build(spheres);
+		REQUIRE(soa.Size() == count);
+
+		for (int i = 0; i < 300; i++)
+		{
+			// Some rays start inside a sphere
+			const auto orig = i % 3 == 0 && count > 0 ? spheres[i % count].position : Vec3f(0);
+			const auto dir = randomDirection();
+			int expectedPrim = -1;
+			float expected = 1e6;
+			for (int j = 0; j < count; j++)
+			{
+				const float distance = spheres[j].HitDistance(orig, dir);
+				if (distance > 0 && distance < expected)
+				{
+					expected = distance;
+					expectedPrim = j;
+				}
+			}
+
+			const auto hit = soa.Closest(orig, dir, 1e6);
+			REQUIRE(hit.prim == expectedPrim);
+			if (expectedPrim >= 0)
+			{
+				REQUIRE(hit.distance == Approx(expected));
+				REQUIRE(soa.Occluded(orig, dir, expected * 1.01f));
+				REQUIRE_FALSE(soa.Occluded(orig, dir, expected * 0.99f));
+			}
+			else
+			{
+				REQUIRE_FALSE(soa.Occluded(orig, dir, 1e6));
+			}
+		}
+	}
+}
+}
+
+TEST_CASE("SIMD sphere kernel matches the scalar sphere test", "[soa]")
+{
+	for (const auto& kernel : soa::Kernels())
+	{
+		// Every variant this CPU runs, not just the one picked at startup
+		if (!util::Supports(kernel.isa))
+			continue;
+		INFO(util::IsaName(kernel.isa));
+		checkKernel(kernel);
+	}
+	REQUIRE(util::Supports(soa::BestKernel().isa));
+	REQUIRE(SphereSoA().Isa() == soa::BestKernel().isa);
+}
@@ -0,0 +1,111 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Utility/TaskGraph.hpp"
+
+TEST_CASE("Task graph runs every part once, after what it depends on", "[taskgraph]")
+{
+	for (const int numThreads : { 1, 2, 8 })
+	{
+		INFO(numThreads << " threads");
+		util::ThreadPool pool(numThreads);
+
+		// a and b are independent, c waits for both and d for c
+		std::atomic<int> partsA { 0 }, partsB { 0 }, partsC { 0 };
+		std::vector<int> runs(64, 0);
+		std::atomic<int> cTooEarly { 0 };
+		bool dSawC = false;
+		util::TaskGraph graph(pool);
+		const auto a = graph.Add("a", 64, [&](const int part, int) {
+			runs[part]++;
+			partsA++;
+		});
+		const auto b = graph.Add("b", [&]() { partsB++; });
+		const auto c = graph.Add("c", 16, [&](int, int) {
+			if (partsA != 64 || partsB != 1)
+				cTooEarly++;
+			partsC++;
+		}, { a, b });
+		graph.Add("d", [&]() { dSawC = partsC == 16; }, { c });
+		REQUIRE(graph.Tasks() == 4);
+		REQUIRE(graph.Name(c) == std::string("c"));
+
+		// The same graph again and again, as every frame does
+		for (int run = 1; run <= 100; run++)
+		{
+			partsA = 0;
+			partsB = 0;
+			partsC = 0;
+			dSawC = false;
+			graph.Run();
+			REQUIRE(partsA == 64);
+			REQUIRE(partsC == 16);
+			REQUIRE(dSawC);
+			REQUIRE(graph.StartMs(c) >= graph.StartMs(a));
+			REQUIRE(graph.Ms(a) >= 0);
+		}
+		REQUIRE(cTooEarly == 0);
+		REQUIRE(std::all_of(runs.begin(), runs.end(), [](const int n) { return n == 100; }));
+	}
+}
+
+TEST_CASE("Task graph hands the parts of one task to the threads another leaves free", "[taskgraph]")
+{
+	util::ThreadPool pool(4);
+	util::TaskGraph graph(pool);
+	std::atomic<bool> longDone { false };
+	std::atomic<int> partsWhileLong { 0 };
+	// The long task waits for the other's parts, so they can only run on the other threads
+	graph.Add("long", [&]() {
+		while (partsWhileLong < 32)
+		{
+			std::this_thread::yield();
+		}
+		longDone = true;
+	});
+	graph.Add("parts", 32, [&](int, int) {
+		if (!longDone)
+			partsWhileLong++;
+	});
+	graph.Run();
+	REQUIRE(partsWhileLong == 32);
+}
+
+TEST_CASE("Task graph runs the parallel loops of its tasks", "[taskgraph]")
+{
+	for (const int numThreads : { 1, 4 })
+	{
+		INFO(numThreads << " threads");
+		util::ThreadPool pool(numThreads);
+		util::TaskGraph graph(pool);
+		REQUIRE(graph.Size() == numThreads);
+
+		// Two tasks running loops at the same time, next to one that doesn't
+		std::vector<int> covered(2 * 10000, 0);
+		const auto loop = [&](const int offset) {
+			util::ParallelFor(&graph, graph.Size() * 4, 10000, [&](int, const int begin, const int end) {
+				for (int i = begin; i < end; i++)
+				{
+					covered[offset + i]++;
+				}
+			});
+		};
+		graph.Add("first", [&]() { loop(0); });
+		graph.Add("second", [&]() { loop(10000); });
+		graph.Add("other", 8, [](int, int) {});
+		for (int run = 1; run <= 50; run++)
+		{
+			graph.Run();
+			REQUIRE(std::all_of(covered.begin(), covered.end(), [run](const int n) { return n == run; }));
+		}
+
+		// Outside of Run the pool takes the chunks
+		loop(0);
+		REQUIRE(covered[0] == 51);
+	}
+}
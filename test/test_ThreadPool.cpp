@@ -0,0 +1,61 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+
+#include "Utility/ThreadPool.hpp"
+
+TEST_CASE("Thread pool runs a job once per thread and waits for all of them", "[threadpool]")
+{
+	for (const int numThreads : { 1, 2, 8 })
+	{
+		util::ThreadPool pool(numThreads);
+		REQUIRE(pool.Size() == numThreads);
+		std::vector<int> runs(numThreads, 0);
+		// Many short jobs in a row, so a worker that misses a wake-up or runs twice shows
+		for (int job = 0; job < 2000; job++)
+		{
+			std::atomic<int> started { 0 };
+			pool.Run([&](const int thread) {
+				started++;
+				runs[thread]++;
+			});
+			REQUIRE(started == numThreads);
+		}
+		REQUIRE(std::all_of(runs.begin(), runs.end(), [](const int n) { return n == 2000; }));
+	}
+}
+
+TEST_CASE("Pinned thread pool still runs every thread", "[threadpool]")
+{
+	const auto cpus = util::AllowedCpus();
+	util::ThreadPool pool(4, cpus);
+	std::vector<int> runs(4, 0);
+	// On a thread of its own, the caller gets pinned as well
+	std::vector<int> callerCpus;
+	std::thread([&]() {
+		pool.Run([&](const int thread) { runs[thread]++; });
+		callerCpus = util::AllowedCpus();
+	}).join();
+	REQUIRE(runs == std::vector<int>(4, 1));
+#if defined(__linux__)
+	REQUIRE(callerCpus == std::vector<int> { cpus[0] });
+#endif
+}
+
+TEST_CASE("Parallel loops run on the pool, also from inside one of its jobs", "[threadpool]")
+{
+	util::ThreadPool pool(4);
+	std::vector<int> covered(1000, 0);
+	util::ParallelFor(&pool, pool.Size(), (int)covered.size(), [&](int, const int begin, const int end) {
+		for (int i = begin; i < end; i++)
+		{
+			covered[i]++;
+		}
+	});
+	REQUIRE(std::all_of(covered.begin(), covered.end(), [](const int n) { return n == 1; }));
+
+	// Run can't be nested, the job's thread does the loop on its own
+	std::atomic<int> chunks { 0 };
+	pool.Run([&](int) { util::ParallelFor(&pool, pool.Size(), 100, [&](int, int, int) { chunks++; }); });
+	REQUIRE(chunks == 4 * 4);
+}
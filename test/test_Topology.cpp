@@ -0,0 +1,38 @@
+#include <catch2/catch.hpp>
+
+#include "Geometry.cpp"
+#include "Utility/FirstTouchArray.hpp"
+#include "Utility/Topology.hpp"
+
+TEST_CASE("CPU quotas round up to whole cores", "[topology]")
+{
+	REQUIRE(util::ParseCpuMax("max 100000") == 0);
+	REQUIRE(util::ParseCpuMax("100000 100000") == 1);
+	REQUIRE(util::ParseCpuMax("150000 100000") == 2);
+	REQUIRE(util::ParseCpuMax("20000 100000") == 1);
+	REQUIRE(util::ParseCpuMax("") == 0);
+	REQUIRE(util::ParseCfsQuota(-1, 100000) == 0);
+	REQUIRE(util::ParseCfsQuota(400000, 100000) == 4);
+	REQUIRE(util::ParseCfsQuota(250000, 100000) == 3);
+}
+
+TEST_CASE("Core count stays within the CPUs we may use", "[topology]")
+{
+	const auto cpus = util::AllowedCpus();
+	REQUIRE(!cpus.empty());
+	REQUIRE(util::CoreCount() >= 1);
+	REQUIRE(util::CoreCount() <= (int)cpus.size());
+}
+
+TEST_CASE("First touch arrays start on a cache line and construct what is touched", "[topology]")
+{
+	util::FirstTouchArray<Vec3f> array(1000);
+	REQUIRE(array.size() == 1000);
+	REQUIRE(reinterpret_cast<uintptr_t>(array.data()) % 64 == 0);
+	array.Touch(0, 500);
+	array.Touch(500, 500);
+	for (const auto& v : array)
+	{
+		REQUIRE((v.x == 0 && v.y == 0 && v.z == 0));
+	}
+}
@@ -0,0 +1,92 @@
+#include <catch2/catch.hpp>
+
+#include "Accel/Accelerator.hpp"
+#include "Render/Wavefront.hpp"
+#include "TestScenes.hpp"
+
+using namespace test;
+
+namespace
+{
+// The recursive castRay of the raytracer, one ray at a time
+Color recursiveRay(const IRayQuery& scene, const std::vector<Light>& lights, const Vec3f& orig, const Vec3f& dir, const int depth)
+{
+	const auto hit = scene.Intersect(orig, dir);
+	if (!(hit.distance > 0 && hit.distance < MAX_RAY_DISTANCE))
+		return Color {};
+
+	uint32_t blocked = 0;
+	for (int i = 0; i < (int)lights.size(); i++)
+	{
+		Vec3f path {};
+		const float lightDistance = LightPath(hit, lights[i], path);
+		if (scene.Occluded(hit.position + hit.normal * SHADOW_BIAS, path * -1.0f, lightDistance))
+			blocked |= 1u << i;
+	}
+
+	Color color = DirectLight(hit, lights, blocked);
+	if (depth < MAX_REFLECTION_DEPTH)
+	{
+		auto reflection = recursiveRay(scene, lights, hit.position, hit.reflection, depth + 1);
+		reflection *= std::pow(0.6, depth + 1);
+		color += reflection;
+	}
+	return color;
+}
+
+std::vector<float> channels(const std::vector<Color>& colors)
+{
+	std::vector<float> out;
+	for (const Color& color : colors)
+	{
+		out.insert(out.end(), { color.r, color.g, color.b });
+	}
+	return out;
+}
+}
+
+TEST_CASE("Wavefront renders the same image as recursive tracing", "[wavefront]")
+{
+	srand(31);
+	auto spheres = randomSpheres(2000);
+	// A few big spheres so reflections bounce a couple of times
+	for (int i = 0; i < 20; i++)
+	{
+		spheres.push_back(Sphere(Vec3f(-4.0f + 8.0f * random01(), -2.0f + 4.0f * random01(), -8.0f - 10.0f * random01()), 1.0f + random01(), Color(200, 120, 60), Vec3f(0)));
+	}
+	const std::vector<Light> lights { Light(Vec3f(-3, 10, -12), 0.9f), Light(Vec3f(4, -8, -20), 0.8f) };
+	const auto directions = primaryDirections(4);
+	const int count = (int)directions.size();
+
+	for (const auto type : { AccelType::BruteForce, AccelType::BVH, AccelType::BVH8 })
+	{
+		auto accelerator = CreateAccelerator(type, (int)spheres.size());
+		accelerator->Build(spheres);
+
+		std::vector<Color> expected(count);
+		for (int i = 0; i < count; i++)
+		{
+			expected[i] = recursiveRay(*accelerator, lights, Vec3f(0), directions[i], 0);
+		}
+
+		for (const auto& [packets, sortRays] : { std::pair { false, false }, std::pair { true, false }, std::pair { true, true } })
+		{
+			Wavefront wavefront;
+			wavefront.packets = packets;
+			wavefront.sortRays = sortRays;
+			std::vector<Color> image(count);
+			wavefront.Render(*accelerator, lights, Vec3f(0), directions.data(), count, image.data());
+			REQUIRE(channels(image) == channels(expected));
+
+			// Every hit but the last bounce's spawns exactly one reflection ray
+			const auto& stats = wavefront.stats;
+			REQUIRE(stats[0].rays == count);
+			REQUIRE(stats[1].rays > 0);
+			for (int b = 0; b + 1 < Wavefront::MAX_BOUNCES; b++)
+			{
+				REQUIRE(stats[b + 1].rays == stats[b].hits);
+				REQUIRE(stats[b].shadowRays == stats[b].hits * (int)lights.size());
+			}
+		}
+	}
+}